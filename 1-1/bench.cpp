@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+// the classes of the solution, its main is renamed out of the way
+#define main SolveFromInput
+#include "main.cpp"
+#undef main
+
+// FindApproximately on a text of size symbols with each strategy: scanning
+// every shift, the correlations for every shift, and the adaptive switch
+// between them. The cases are a repetitive text, where scanning compares
+// the whole pattern at every shift, and random texts, where it stops after
+// a few symbols. Times are in ms with the output written to memory, and the
+// outputs of the strategies must be equal. Scanning is skipped beyond
+// MAX_SCANNED_COMPARISONS_.
+//
+// g++ -std=c++17 -O2 bench.cpp -o bench && ./bench [size]
+class CrossoverBenchmark {
+ public:
+  explicit CrossoverBenchmark(size_t size) : size_(size) {}
+
+  bool operator()() {
+    printf("%-32s %10s %10s %10s\n", "case", "scan", "correlate",
+           "adaptive");
+    std::mt19937 generator(11);
+    std::string repetitive_text(size_, 'a');
+    for (size_t pattern_size : {64, 256, 4096, 65536}) {
+      std::string pattern(pattern_size - 1, 'a');
+      pattern += '?';
+      std::string name = "\"aaa..\", m = " + std::to_string(pattern_size);
+      if (!Run(name, pattern, repetitive_text, 0)) {
+        return false;
+      }
+    }
+
+    std::string text = RandomText(generator, true);
+    std::string pattern = text.substr(text.size() / 2, PATTERN_SIZE_);
+    for (size_t i = 0; i < pattern.size(); i += 16) {
+      pattern[i] = WILDCARD_;
+    }
+    if (!Run("random a-z with '?', m = 4096", pattern, text, 0)) {
+      return false;
+    }
+
+    text = RandomText(generator, false);
+    pattern = text.substr(text.size() / 2, PATTERN_SIZE_);
+    return Run("random a-z, k = 5, m = 4096", pattern, text, 5);
+  }
+
+ private:
+  constexpr static const size_t PATTERN_SIZE_ = 4096;
+  constexpr static const char WILDCARD_ = '?';
+  constexpr static const double MAX_SCANNED_COMPARISONS_ = 2e10;
+
+  bool Run(const std::string& name, const std::string& pattern,
+           const std::string& text, int max_mismatches) const {
+    SubstringFinder::Strategy strategies[3] = {
+        SubstringFinder::SCAN_ONLY_, SubstringFinder::CORRELATE_ONLY_,
+        SubstringFinder::ADAPTIVE_};
+    std::string outputs[3];
+    bool is_run[3] = {false, false, false};
+    printf("%-32s", name.c_str());
+    for (int i = 0; i < 3; ++i) {
+      if (strategies[i] == SubstringFinder::SCAN_ONLY_ &&
+          double(pattern.size()) * text.size() > MAX_SCANNED_COMPARISONS_) {
+        printf(" %10s", "-");
+        continue;
+      }
+      SubstringFinder finder;
+      finder.pattern_ = pattern;
+      finder.string_ = pattern + "#" + text;
+      finder.max_mismatches_ = max_mismatches;
+      finder.strategy_ = strategies[i];
+
+      std::ostringstream output;
+      std::streambuf* standard_output = std::cout.rdbuf(output.rdbuf());
+      auto start = std::chrono::steady_clock::now();
+      finder.FindApproximately();
+      double time = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+      std::cout.rdbuf(standard_output);
+      outputs[i] = output.str();
+      is_run[i] = true;
+      printf(" %10.0f", time);
+      fflush(stdout);
+    }
+    printf("\n");
+    for (int i = 0; i < 2; ++i) {
+      if (is_run[i] && outputs[i] != outputs[2]) {
+        printf("the strategies found different shifts\n");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // a-z, with a wildcard at every 64th symbol on average if asked
+  std::string RandomText(std::mt19937& generator, bool has_wildcards) const {
+    std::string text(size_, 0);
+    for (auto&& symbol : text) {
+      symbol = has_wildcards && generator() % 64 == 0
+                   ? WILDCARD_
+                   : 'a' + generator() % 26;
+    }
+    return text;
+  }
+
+  size_t size_;
+};
+
+int main(int argc, char** argv) {
+  CrossoverBenchmark benchmark(argc > 1 ? atol(argv[1]) : 1000000);
+
+  return benchmark() ? 0 : 1;
+}
@@ -1,25 +1,68 @@
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "../FFT/fft.h"
+
 class SubstringFinder {
  public:
   void operator()() {
     std::ios::sync_with_stdio(false);
     std::cin.tie(nullptr);
     Read();
-    FindSubstring();
+    // string_ holds both the pattern and the text
+    if (max_mismatches_ == 0 &&
+        string_.find(WILDCARD_) == std::string::npos) {
+      FindSubstring();
+    } else {
+      FindApproximately();
+    }
   }
 
  private:
+  // Values of the symbols of the pattern and of the text, the correlation
+  // of the term at a shift i is sum_j pattern_values_[p_j] *
+  // text_values_[t_(i+j)].
+  struct Term {
+    std::vector<uint32_t> pattern_values_;
+    std::vector<uint32_t> text_values_;
+  };
+
+  // The shifts FindApproximately scans before taking the rest from the
+  // correlations: while scanning is cheaper, or all or none of them, which
+  // CrossoverBenchmark of bench.cpp compares.
+  enum Strategy { ADAPTIVE_, SCAN_ONLY_, CORRELATE_ONLY_ };
+  friend class CrossoverBenchmark;
+
+  constexpr static const char WILDCARD_ = '?';
+  // a transform of a term costs about this many comparisons of scanning a
+  // shift for every doubling of the block
+  constexpr static const uint64_t COMPARISONS_PER_TRANSFORM_ = 3;
+  constexpr static const uint32_t MODULUS_ =
+      NumberTheoreticTransform::MODULUS_;
+  constexpr static const int ALPHABET_SIZE_ = 256;
+  constexpr static const size_t MAX_BLOCK_SIZE_ =
+      size_t(1) << NumberTheoreticTransform::MAX_LOG_SIZE_;
+
   std::string pattern_;
+  // the pattern, '#' and the text, which is kept only here
   std::string string_;
   std::vector<int> z_function_values_;
+  // the wildcard matches any symbol, and a match may differ in at most
+  // max_mismatches_ other symbols
+  int max_mismatches_ = 0;
+  Strategy strategy_ = ADAPTIVE_;
 
   void Read() {
     std::cin >> pattern_;
+    // inserted in place while the capacity the text was read into allows
     std::cin >> string_;
-    string_ = pattern_ + "#" + string_;
+    string_.insert(0, pattern_ + "#");
+    if (!(std::cin >> max_mismatches_)) {
+      max_mismatches_ = 0;
+    }
   }
 
   void FindSubstring() {
@@ -28,8 +71,10 @@ class SubstringFinder {
     int right = 0;
     z_function_values_[0] = 0;
     for (int i = 1; i < string_.size(); ++i) {
+      // only the values of the pattern are kept, those behind right are
+      // not needed
       int current_z =
-          std::max(0, std::min(right - i, z_function_values_[i - left]));
+          i < right ? std::min(right - i, z_function_values_[i - left]) : 0;
 
       while (i + current_z < string_.size() &&
              string_[current_z] == string_[i + current_z]) {
@@ -47,6 +92,200 @@ class SubstringFinder {
       }
     }
   }
+
+  // The shifts are scanned while the comparisons per shift cost less than
+  // the transforms, the rest are taken from the correlations: scanning stops
+  // after a few symbols of a random text and at none of a repetitive one.
+  // The distance of a correlation is zero for a match and is the number of
+  // mismatches if they are counted.
+  void FindApproximately() {
+    const char* text = Text();
+    if (pattern_.size() > TextSize()) {
+      return;
+    }
+    size_t shifts = TextSize() - pattern_.size() + 1;
+    std::vector<Term> terms = max_mismatches_ == 0 && DoSquaresFit()
+                                  ? SquareTerms()
+                                  : MismatchTerms();
+    size_t block_size = BlockSize();
+    uint64_t comparisons_per_shift =
+        pattern_.size() > MAX_BLOCK_SIZE_
+            ? pattern_.size()
+            : COMPARISONS_PER_TRANSFORM_ * terms.size() * Log2(block_size);
+
+    // a few early matches do not stop scanning
+    uint64_t comparisons = 0;
+    uint64_t spare_comparisons = 2 * pattern_.size();
+    size_t shift = 0;
+    for (; shift < shifts &&
+           (strategy_ == SCAN_ONLY_ ||
+            (strategy_ == ADAPTIVE_ &&
+             comparisons <= comparisons_per_shift * shift + spare_comparisons));
+         ++shift) {
+      int mismatches = 0;
+      size_t j = 0;
+      for (; j < pattern_.size() && mismatches <= max_mismatches_; ++j) {
+        if (pattern_[j] != text[shift + j] && pattern_[j] != WILDCARD_ &&
+            text[shift + j] != WILDCARD_) {
+          ++mismatches;
+        }
+      }
+      comparisons += j;
+      if (mismatches <= max_mismatches_) {
+        std::cout << shift << " ";
+      }
+    }
+    if (shift == shifts) {
+      return;
+    }
+
+    std::vector<uint32_t> distances = Correlate(terms, shift, block_size);
+    for (size_t i = 0; i < distances.size(); ++i) {
+      if (distances[i] <= uint32_t(max_mismatches_)) {
+        std::cout << shift + i << " ";
+      }
+    }
+  }
+
+  const char* Text() const { return string_.data() + pattern_.size() + 1; }
+  size_t TextSize() const { return string_.size() - pattern_.size() - 1; }
+
+  // the symbols numbered from 1 in their order, the wildcard is 0
+  std::vector<uint32_t> Numbers() const {
+    std::vector<uint32_t> numbers(ALPHABET_SIZE_, 0);
+    for (char symbol : pattern_) {
+      numbers[static_cast<unsigned char>(symbol)] = 1;
+    }
+    for (const char* symbol = Text(); symbol != Text() + TextSize();
+         ++symbol) {
+      numbers[static_cast<unsigned char>(*symbol)] = 1;
+    }
+    numbers[static_cast<unsigned char>(WILDCARD_)] = 0;
+    uint32_t number = 0;
+    for (auto&& value : numbers) {
+      if (value != 0) {
+        value = ++number;
+      }
+    }
+    return numbers;
+  }
+
+  // the sum of the squares below the modulus
+  bool DoSquaresFit() const {
+    std::vector<uint32_t> numbers = Numbers();
+    uint64_t greatest = *std::max_element(numbers.begin(), numbers.end());
+    uint64_t difference = greatest > 0 ? greatest - 1 : 0;
+    return difference * difference * pattern_.size() < MODULUS_;
+  }
+
+  // With a and b the numbers of the symbols of the pattern and of the text
+  // and [x] for not a wildcard, sum_j [a] [b] (a - b)^2 is zero exactly
+  // for a match. It is [a] b^2 - 2 a b + a^2 [b], three terms.
+  std::vector<Term> SquareTerms() const {
+    std::vector<uint32_t> numbers = Numbers();
+    std::vector<Term> terms(3, {std::vector<uint32_t>(ALPHABET_SIZE_),
+                                std::vector<uint32_t>(ALPHABET_SIZE_)});
+    for (int symbol = 0; symbol < ALPHABET_SIZE_; ++symbol) {
+      uint64_t number = numbers[symbol];
+      uint32_t is_symbol = number > 0 ? 1 : 0;
+      terms[0].pattern_values_[symbol] = is_symbol;
+      terms[0].text_values_[symbol] = number * number;
+      terms[1].pattern_values_[symbol] = (MODULUS_ - 2 * number) % MODULUS_;
+      terms[1].text_values_[symbol] = number;
+      terms[2].pattern_values_[symbol] = number * number;
+      terms[2].text_values_[symbol] = is_symbol;
+    }
+    return terms;
+  }
+
+  // the pairs without wildcards minus the equal pairs of every symbol of
+  // the pattern, a term a symbol
+  std::vector<Term> MismatchTerms() const {
+    std::vector<bool> is_in_pattern(ALPHABET_SIZE_, false);
+    for (char symbol : pattern_) {
+      is_in_pattern[static_cast<unsigned char>(symbol)] = true;
+    }
+    is_in_pattern[static_cast<unsigned char>(WILDCARD_)] = false;
+
+    std::vector<Term> terms(1, {std::vector<uint32_t>(ALPHABET_SIZE_, 1),
+                                std::vector<uint32_t>(ALPHABET_SIZE_, 1)});
+    terms[0].pattern_values_[static_cast<unsigned char>(WILDCARD_)] = 0;
+    terms[0].text_values_[static_cast<unsigned char>(WILDCARD_)] = 0;
+    for (int symbol = 0; symbol < ALPHABET_SIZE_; ++symbol) {
+      if (is_in_pattern[symbol]) {
+        terms.push_back({std::vector<uint32_t>(ALPHABET_SIZE_, 0),
+                         std::vector<uint32_t>(ALPHABET_SIZE_, 0)});
+        terms.back().pattern_values_[symbol] = MODULUS_ - 1;
+        terms.back().text_values_[symbol] = 1;
+      }
+    }
+    return terms;
+  }
+
+  // a power of two about twice the pattern, not above the text
+  size_t BlockSize() const {
+    size_t block_size = 1;
+    while (block_size < 2 * pattern_.size() && block_size < TextSize() &&
+           block_size < MAX_BLOCK_SIZE_) {
+      block_size *= 2;
+    }
+    return block_size;
+  }
+
+  // The correlations for the shifts from first_shift, summed over the terms.
+  // The text is cut into blocks, a block gives the shifts where the pattern
+  // lies in it, and the next one starts after them. So the transforms are of
+  // O(m) and the time is O(n log m) for every term. The transforms of the
+  // pattern are reused, those of the terms are summed before the inverse
+  // transform.
+  std::vector<uint32_t> Correlate(const std::vector<Term>& terms,
+                                  size_t first_shift,
+                                  size_t block_size) const {
+    const char* text = Text();
+    size_t text_size = TextSize();
+    size_t pattern_size = pattern_.size();
+    size_t step = block_size - pattern_size + 1;
+    NumberTheoreticTransform transform(block_size);
+
+    std::vector<std::vector<uint32_t>> pattern_spectra(terms.size());
+    for (size_t term = 0; term < terms.size(); ++term) {
+      std::vector<uint32_t>& spectrum = pattern_spectra[term];
+      spectrum.assign(block_size, 0);
+      for (size_t j = 0; j < pattern_size; ++j) {
+        spectrum[pattern_size - 1 - j] = terms[term].pattern_values_[
+            static_cast<unsigned char>(pattern_[j])];
+      }
+      transform.Transform(spectrum);
+    }
+
+    std::vector<uint32_t> correlations(text_size - pattern_size + 1 -
+                                       first_shift);
+    std::vector<uint32_t> block(block_size);
+    std::vector<uint32_t> sum(block_size);
+    for (size_t start = 0; start < correlations.size(); start += step) {
+      std::fill(sum.begin(), sum.end(), 0);
+      for (size_t term = 0; term < terms.size(); ++term) {
+        for (size_t i = 0; i < block_size; ++i) {
+          size_t position = first_shift + start + i;
+          block[i] = position < text_size
+                         ? terms[term].text_values_[
+                               static_cast<unsigned char>(text[position])]
+                         : 0;
+        }
+        transform.Transform(block);
+        for (size_t i = 0; i < block_size; ++i) {
+          sum[i] = (sum[i] + uint64_t(block[i]) * pattern_spectra[term][i]) %
+                   MODULUS_;
+        }
+      }
+      transform.InverseTransform(sum);
+      size_t end = std::min(start + step, correlations.size());
+      for (size_t i = start; i < end; ++i) {
+        correlations[i] = sum[i - start + pattern_size - 1];
+      }
+    }
+    return correlations;
+  }
 };
 
 int main() {
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+// the classes of the solution, its main is renamed out of the way
+#define main SolveFromInput
+#include "main.cpp"
+#undef main
+
+// g++ -std=c++17 -O2 bench.cpp -o bench && ./bench [log_size] [pattern_size]
+
+// Random lowercase text of 2^log_size characters. Compares the FM-index with
+// the suffix array it is built from: bytes per character, Count against two
+// binary searches over the suffix array, and Locate, for patterns cut out of
+// the text.
+class FmIndexBenchmark {
+ public:
+  FmIndexBenchmark(int log_size, int pattern_size)
+      : size_(size_t(1) << log_size), pattern_size_(pattern_size) {}
+
+  void operator()() {
+    std::mt19937 generator(1);
+    std::string text(size_, 0);
+    for (auto&& symbol : text) {
+      symbol = 'a' + generator() % 26;
+    }
+    std::vector<std::string> patterns(NUMBER_OF_PATTERNS_);
+    for (auto&& pattern : patterns) {
+      pattern = text.substr(generator() % (size_ - pattern_size_ + 1),
+                            pattern_size_);
+    }
+
+    FindNumberOfSubstrings solver;
+    solver(text);
+    const std::string& string = solver.GetString();
+    const std::vector<int>& suffix_array = solver.GetSuffixArray();
+    FmIndex index(string, suffix_array);
+    printf("%zu characters: fm-index %.2f bytes/char, suffix array %.2f\n",
+           size_, double(index.MemoryUsage()) / size_,
+           double(sizeof(int)) * suffix_array.size() / size_);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t fm_count = 0;
+    for (auto&& pattern : patterns) {
+      fm_count += index.Count(pattern);
+    }
+    double fm_time = Microseconds(start) / patterns.size();
+
+    start = std::chrono::steady_clock::now();
+    size_t array_count = 0;
+    for (auto&& pattern : patterns) {
+      auto begin = std::lower_bound(
+          suffix_array.begin(), suffix_array.end(), pattern,
+          [&](int suffix, const std::string& pattern) {
+            return string.compare(suffix, pattern.size(), pattern) < 0;
+          });
+      auto end = std::upper_bound(
+          begin, suffix_array.end(), pattern,
+          [&](const std::string& pattern, int suffix) {
+            return string.compare(suffix, pattern.size(), pattern) > 0;
+          });
+      array_count += end - begin;
+    }
+    double array_time = Microseconds(start) / patterns.size();
+    printf("count: fm-index %.2f us, suffix array %.2f us%s\n", fm_time,
+           array_time, fm_count == array_count ? "" : " (counts differ)");
+
+    start = std::chrono::steady_clock::now();
+    size_t occurrences = 0;
+    for (size_t i = 0; i < NUMBER_OF_LOCATED_; ++i) {
+      occurrences += index.Locate(patterns[i]).size();
+    }
+    printf("locate: %.2f us per pattern, %.2f occurrences\n",
+           Microseconds(start) / NUMBER_OF_LOCATED_,
+           double(occurrences) / NUMBER_OF_LOCATED_);
+  }
+
+ private:
+  constexpr static const size_t NUMBER_OF_PATTERNS_ = 100000;
+  constexpr static const size_t NUMBER_OF_LOCATED_ = 10000;
+
+  static double Microseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
+
+  size_t size_;
+  size_t pattern_size_;
+};
+
+// Random lowercase text of 2^log_size characters read one by one into the
+// suffix automaton, against a single suffix array build of the whole text,
+// which is what every character would cost without the automaton.
+class SuffixAutomatonBenchmark {
+ public:
+  explicit SuffixAutomatonBenchmark(int log_size)
+      : size_(size_t(1) << log_size) {}
+
+  void operator()() {
+    std::mt19937 generator(2);
+    std::string text(size_, 0);
+    for (auto&& symbol : text) {
+      symbol = 'a' + generator() % 26;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SuffixAutomaton automaton(size_);
+    for (char symbol : text) {
+      automaton.Append(symbol);
+    }
+    double automaton_time = Seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    FindNumberOfSubstrings solver;
+    solver(text);
+    double rebuild_time = Seconds(start);
+    printf("%zu characters: automaton %.2f s (%.0f ns/char), one suffix "
+           "array build %.2f s\n",
+           size_, automaton_time, 1e9 * automaton_time / size_,
+           rebuild_time);
+  }
+
+ private:
+  static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+  size_t size_;
+};
+
+int main(int argc, char** argv) {
+  int log_size = argc > 1 ? atoi(argv[1]) : 21;
+  int pattern_size = argc > 2 ? atoi(argv[2]) : 6;
+
+  FmIndexBenchmark fm_index_benchmark(log_size, pattern_size);
+  fm_index_benchmark();
+  SuffixAutomatonBenchmark automaton_benchmark(log_size - 1);
+  automaton_benchmark();
+
+  return 0;
+}
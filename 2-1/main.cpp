@@ -1,3 +1,4 @@
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -6,6 +7,9 @@ class FindNumberOfSubstrings {
  public:
   int operator()(const std::string& input_string);
 
+  const std::string& GetString() const { return string_; }
+  const std::vector<int>& GetSuffixArray() const { return permutation_; }
+
  private:
   void SplitIntoEquivalenceClasses();
   void FindLcp();
@@ -116,6 +120,410 @@ int FindNumberOfSubstrings::operator()(const std::string& input_string) {
   return number_of_subtrings;
 }
 
+class BitVector {
+ public:
+  explicit BitVector(size_t size = 0)
+      : size_(size), words_((size + WORD_SIZE_ - 1) / WORD_SIZE_, 0) {}
+
+  void Set(size_t index) {
+    words_[index / WORD_SIZE_] |= uint64_t(1) << (index % WORD_SIZE_);
+  }
+  bool Get(size_t index) const {
+    return (words_[index / WORD_SIZE_] >> (index % WORD_SIZE_)) & 1;
+  }
+
+  void BuildRank();
+  // number of set bits in [0, index)
+  size_t Rank(size_t index) const;
+  size_t MemoryUsage() const;
+
+ private:
+  static const size_t WORD_SIZE_ = 64;
+  static const size_t WORDS_PER_BLOCK_ = 8;
+
+  size_t size_;
+  std::vector<uint64_t> words_;
+  std::vector<uint32_t> block_ranks_;
+};
+
+void BitVector::BuildRank() {
+  block_ranks_.assign(words_.size() / WORDS_PER_BLOCK_ + 1, 0);
+  uint32_t counter = 0;
+  for (size_t i = 0; i < words_.size(); ++i) {
+    if (i % WORDS_PER_BLOCK_ == 0) {
+      block_ranks_[i / WORDS_PER_BLOCK_] = counter;
+    }
+    counter += __builtin_popcountll(words_[i]);
+  }
+  if (words_.size() % WORDS_PER_BLOCK_ == 0) {
+    block_ranks_.back() = counter;
+  }
+}
+
+size_t BitVector::Rank(size_t index) const {
+  size_t word = index / WORD_SIZE_;
+  size_t result = block_ranks_[word / WORDS_PER_BLOCK_];
+  for (size_t i = word - word % WORDS_PER_BLOCK_; i < word; ++i) {
+    result += __builtin_popcountll(words_[i]);
+  }
+  if (index % WORD_SIZE_ != 0) {
+    result += __builtin_popcountll(words_[word] &
+                                   ((uint64_t(1) << (index % WORD_SIZE_)) - 1));
+  }
+  return result;
+}
+
+size_t BitVector::MemoryUsage() const {
+  return words_.size() * sizeof(uint64_t) +
+         block_ranks_.size() * sizeof(uint32_t);
+}
+
+// Wavelet matrix over the alphabet actually present in the text, so a string
+// of lowercase letters costs 5 bits per symbol instead of 8.
+class WaveletMatrix {
+ public:
+  WaveletMatrix() = default;
+  explicit WaveletMatrix(const std::string& string);
+
+  unsigned char Access(size_t index) const;
+  // occurrences of symbol in [0, index)
+  size_t Rank(unsigned char symbol, size_t index) const;
+  bool Contains(unsigned char symbol) const { return codes_[symbol] != -1; }
+  size_t MemoryUsage() const;
+
+ private:
+  std::vector<int> codes_ = std::vector<int>(ALPHABET_SIZE_, -1);
+  std::vector<unsigned char> symbols_;
+  std::vector<BitVector> levels_;
+  std::vector<size_t> zeros_;
+  static const int ALPHABET_SIZE_ = 256;
+};
+
+WaveletMatrix::WaveletMatrix(const std::string& string) {
+  for (auto&& symbol : string) {
+    codes_[static_cast<unsigned char>(symbol)] = 0;
+  }
+  for (int symbol = 0; symbol < ALPHABET_SIZE_; ++symbol) {
+    if (codes_[symbol] != -1) {
+      codes_[symbol] = symbols_.size();
+      symbols_.push_back(symbol);
+    }
+  }
+
+  int number_of_levels = 1;
+  while ((size_t(1) << number_of_levels) < symbols_.size()) {
+    ++number_of_levels;
+  }
+
+  std::vector<int> current(string.size());
+  for (size_t i = 0; i < string.size(); ++i) {
+    current[i] = codes_[static_cast<unsigned char>(string[i])];
+  }
+  std::vector<int> next(string.size());
+
+  levels_.assign(number_of_levels, BitVector(string.size()));
+  zeros_.assign(number_of_levels, 0);
+  for (int level = 0; level < number_of_levels; ++level) {
+    int bit = number_of_levels - level - 1;
+    for (size_t i = 0; i < current.size(); ++i) {
+      if ((current[i] >> bit) & 1) {
+        levels_[level].Set(i);
+      } else {
+        next[zeros_[level]++] = current[i];
+      }
+    }
+    size_t ones = zeros_[level];
+    for (auto&& code : current) {
+      if ((code >> bit) & 1) {
+        next[ones++] = code;
+      }
+    }
+    levels_[level].BuildRank();
+    current.swap(next);
+  }
+}
+
+unsigned char WaveletMatrix::Access(size_t index) const {
+  int code = 0;
+  for (size_t level = 0; level < levels_.size(); ++level) {
+    bool bit = levels_[level].Get(index);
+    size_t ones = levels_[level].Rank(index);
+    index = bit ? zeros_[level] + ones : index - ones;
+    code = (code << 1) | bit;
+  }
+  return symbols_[code];
+}
+
+size_t WaveletMatrix::Rank(unsigned char symbol, size_t index) const {
+  int code = codes_[symbol];
+  if (code == -1) {
+    return 0;
+  }
+  size_t begin = 0;
+  for (size_t level = 0; level < levels_.size(); ++level) {
+    bool bit = (code >> (levels_.size() - level - 1)) & 1;
+    size_t begin_ones = levels_[level].Rank(begin);
+    size_t index_ones = levels_[level].Rank(index);
+    if (bit) {
+      begin = zeros_[level] + begin_ones;
+      index = zeros_[level] + index_ones;
+    } else {
+      begin -= begin_ones;
+      index -= index_ones;
+    }
+  }
+  return index - begin;
+}
+
+size_t WaveletMatrix::MemoryUsage() const {
+  size_t result = codes_.size() * sizeof(int) + symbols_.size() +
+                  zeros_.size() * sizeof(size_t);
+  for (auto&& level : levels_) {
+    result += level.MemoryUsage();
+  }
+  return result;
+}
+
+// Compressed full-text index: BWT stored in a wavelet matrix plus every
+// sample_rate-th text position of the suffix array. The suffix array itself
+// can be dropped after construction.
+class FmIndex {
+ public:
+  FmIndex(const std::string& string, const std::vector<int>& suffix_array,
+          int sample_rate = 32);
+
+  size_t Count(const std::string& pattern) const;
+  std::vector<int> Locate(const std::string& pattern) const;
+  size_t MemoryUsage() const;
+
+ private:
+  bool BackwardSearch(const std::string& pattern, size_t& begin,
+                      size_t& end) const;
+  size_t LastToFirst(size_t index) const;
+
+  WaveletMatrix bwt_;
+  std::vector<size_t> first_occurrence_;
+  BitVector is_sampled_;
+  std::vector<int> samples_;
+  int sample_rate_;
+  const int ALPHABET_SIZE_ = 256;
+};
+
+FmIndex::FmIndex(const std::string& string,
+                 const std::vector<int>& suffix_array, int sample_rate)
+    : is_sampled_(string.size()), sample_rate_(sample_rate) {
+  std::string bwt(string.size(), 0);
+  first_occurrence_.assign(ALPHABET_SIZE_ + 1, 0);
+  for (size_t i = 0; i < string.size(); ++i) {
+    bwt[i] = string[(suffix_array[i] + string.size() - 1) % string.size()];
+    ++first_occurrence_[static_cast<unsigned char>(string[i]) + 1];
+
+    if (suffix_array[i] % sample_rate_ == 0) {
+      is_sampled_.Set(i);
+      samples_.push_back(suffix_array[i]);
+    }
+  }
+  for (int i = 1; i <= ALPHABET_SIZE_; ++i) {
+    first_occurrence_[i] += first_occurrence_[i - 1];
+  }
+  is_sampled_.BuildRank();
+  bwt_ = WaveletMatrix(bwt);
+}
+
+size_t FmIndex::LastToFirst(size_t index) const {
+  unsigned char symbol = bwt_.Access(index);
+  return first_occurrence_[symbol] + bwt_.Rank(symbol, index);
+}
+
+bool FmIndex::BackwardSearch(const std::string& pattern, size_t& begin,
+                             size_t& end) const {
+  begin = 0;
+  end = first_occurrence_.back();
+  for (auto it = pattern.rbegin(); it != pattern.rend() && begin < end; ++it) {
+    auto symbol = static_cast<unsigned char>(*it);
+    if (!bwt_.Contains(symbol)) {
+      return false;
+    }
+    begin = first_occurrence_[symbol] + bwt_.Rank(symbol, begin);
+    end = first_occurrence_[symbol] + bwt_.Rank(symbol, end);
+  }
+  return begin < end;
+}
+
+size_t FmIndex::Count(const std::string& pattern) const {
+  size_t begin = 0;
+  size_t end = 0;
+  if (!BackwardSearch(pattern, begin, end)) {
+    return 0;
+  }
+  return end - begin;
+}
+
+std::vector<int> FmIndex::Locate(const std::string& pattern) const {
+  std::vector<int> result;
+  size_t begin = 0;
+  size_t end = 0;
+  if (!BackwardSearch(pattern, begin, end)) {
+    return result;
+  }
+
+  for (size_t i = begin; i < end; ++i) {
+    size_t index = i;
+    int steps = 0;
+    while (!is_sampled_.Get(index)) {
+      index = LastToFirst(index);
+      ++steps;
+    }
+    result.push_back(samples_[is_sampled_.Rank(index)] + steps);
+  }
+  return result;
+}
+
+size_t FmIndex::MemoryUsage() const {
+  return bwt_.MemoryUsage() + first_occurrence_.size() * sizeof(size_t) +
+         is_sampled_.MemoryUsage() + samples_.size() * sizeof(int);
+}
+
+// Online distinct substring counter. Transitions live in flat arrays: every
+// state keeps a singly linked list of its edges (needed to copy them into a
+// clone) and an open addressing table keyed by (state, symbol) finds an edge
+// in O(1), so appending a character costs amortized O(1).
+class SuffixAutomaton {
+ public:
+  explicit SuffixAutomaton(size_t expected_size = 0);
+
+  // returns the number of distinct substrings of the text read so far
+  long long Append(char symbol);
+  long long NumberOfSubstrings() const { return number_of_substrings_; }
+
+ private:
+  static uint64_t Key(int state, char symbol) {
+    return (static_cast<uint64_t>(state) << 8) |
+           static_cast<unsigned char>(symbol);
+  }
+  size_t Slot(uint64_t key) const {
+    return (key * 0x9E3779B97F4A7C15ULL >> 32) & (table_keys_.size() - 1);
+  }
+
+  int FindTransition(int state, char symbol) const;
+  void AddTransition(int state, char symbol, int target);
+  void InsertIntoTable(uint64_t key, int edge);
+  int CreateState(int length, int link);
+
+  std::vector<int> length_;
+  std::vector<int> link_;
+  std::vector<int> first_edge_;
+
+  std::vector<int> next_edge_;
+  std::vector<char> edge_symbol_;
+  std::vector<int> edge_target_;
+
+  std::vector<uint64_t> table_keys_;
+  std::vector<int> table_edges_;
+
+  int last_ = 0;
+  long long number_of_substrings_ = 0;
+};
+
+SuffixAutomaton::SuffixAutomaton(size_t expected_size) {
+  length_.reserve(2 * expected_size + 1);
+  link_.reserve(2 * expected_size + 1);
+  first_edge_.reserve(2 * expected_size + 1);
+  next_edge_.reserve(3 * expected_size);
+  edge_symbol_.reserve(3 * expected_size);
+  edge_target_.reserve(3 * expected_size);
+
+  size_t table_size = 16;
+  while (table_size < 6 * expected_size) {
+    table_size *= 2;
+  }
+  table_keys_.assign(table_size, 0);
+  table_edges_.assign(table_size, -1);
+
+  CreateState(0, -1);
+}
+
+int SuffixAutomaton::CreateState(int length, int link) {
+  length_.push_back(length);
+  link_.push_back(link);
+  first_edge_.push_back(-1);
+  return static_cast<int>(length_.size()) - 1;
+}
+
+int SuffixAutomaton::FindTransition(int state, char symbol) const {
+  uint64_t key = Key(state, symbol);
+  for (size_t slot = Slot(key); table_edges_[slot] != -1;
+       slot = (slot + 1) & (table_keys_.size() - 1)) {
+    if (table_keys_[slot] == key) {
+      return table_edges_[slot];
+    }
+  }
+  return -1;
+}
+
+void SuffixAutomaton::InsertIntoTable(uint64_t key, int edge) {
+  size_t slot = Slot(key);
+  while (table_edges_[slot] != -1) {
+    slot = (slot + 1) & (table_keys_.size() - 1);
+  }
+  table_keys_[slot] = key;
+  table_edges_[slot] = edge;
+}
+
+void SuffixAutomaton::AddTransition(int state, char symbol, int target) {
+  next_edge_.push_back(first_edge_[state]);
+  edge_symbol_.push_back(symbol);
+  edge_target_.push_back(target);
+  first_edge_[state] = static_cast<int>(next_edge_.size()) - 1;
+
+  if (2 * next_edge_.size() > table_keys_.size()) {
+    table_keys_.assign(2 * table_keys_.size(), 0);
+    table_edges_.assign(table_keys_.size(), -1);
+    for (int from = 0; from < static_cast<int>(first_edge_.size()); ++from) {
+      for (int edge = first_edge_[from]; edge != -1; edge = next_edge_[edge]) {
+        InsertIntoTable(Key(from, edge_symbol_[edge]), edge);
+      }
+    }
+  } else {
+    InsertIntoTable(Key(state, symbol), first_edge_[state]);
+  }
+}
+
+long long SuffixAutomaton::Append(char symbol) {
+  int current = CreateState(length_[last_] + 1, 0);
+  int state = last_;
+  while (state != -1 && FindTransition(state, symbol) == -1) {
+    AddTransition(state, symbol, current);
+    state = link_[state];
+  }
+
+  if (state != -1) {
+    int next = edge_target_[FindTransition(state, symbol)];
+    if (length_[state] + 1 == length_[next]) {
+      link_[current] = next;
+    } else {
+      int clone = CreateState(length_[state] + 1, link_[next]);
+      for (int edge = first_edge_[next]; edge != -1; edge = next_edge_[edge]) {
+        AddTransition(clone, edge_symbol_[edge], edge_target_[edge]);
+      }
+      while (state != -1) {
+        int edge = FindTransition(state, symbol);
+        if (edge == -1 || edge_target_[edge] != next) {
+          break;
+        }
+        edge_target_[edge] = clone;
+        state = link_[state];
+      }
+      link_[next] = clone;
+      link_[current] = clone;
+    }
+  }
+
+  last_ = current;
+  number_of_substrings_ += length_[current] - length_[link_[current]];
+  return number_of_substrings_;
+}
+
 int main() {
   std::string input_string;
 
@@ -0,0 +1,200 @@
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// the classes of the solution, its main is renamed out of the way
+#define main SolveFromInput
+#include "main.cpp"
+#undef main
+
+// Builds the tree of the task, s + t over 'a'..'z', with one child storage
+// policy and looks up substrings of the text and random strings in it. The
+// peak memory of the process is printed too, so a policy is measured in a
+// run of its own.
+//
+// g++ -std=c++17 -O2 bench.cpp -o bench &&
+//     ./bench sorted|dense|hash [size] or ./bench saved [size] [path]
+template <class ChildStorage>
+class ChildStorageBenchmark {
+ public:
+  explicit ChildStorageBenchmark(size_t size) : size_(size) {}
+
+  void operator()() {
+    std::mt19937 generator(1);
+    std::string first_string = RandomString(size_, generator);
+    std::string second_string = RandomString(size_, generator);
+    std::vector<std::string> patterns(NUMBER_OF_PATTERNS_);
+    for (size_t i = 0; i < patterns.size(); ++i) {
+      if (i % 2 == 0) {
+        patterns[i] = first_string.substr(
+            generator() % (size_ - PATTERN_SIZE_), PATTERN_SIZE_);
+      } else {
+        patterns[i] = RandomString(PATTERN_SIZE_, generator);
+      }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SuffixTree<ChildStorage> tree(first_string + second_string,
+                                  first_string.size());
+    double build_time = Seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (auto&& pattern : patterns) {
+      found += tree.Contains(pattern);
+    }
+    double lookup_time = Seconds(start);
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("build %.3f s, %.0f ns per lookup (%zu found), peak %ld MB\n",
+           build_time, 1e9 * lookup_time / patterns.size(), found,
+           usage.ru_maxrss / 1024);
+  }
+
+ private:
+  constexpr static const size_t NUMBER_OF_PATTERNS_ = 100000;
+  constexpr static const size_t PATTERN_SIZE_ = 8;
+
+  static std::string RandomString(size_t size, std::mt19937& generator) {
+    std::string string(size, 0);
+    for (auto&& symbol : string) {
+      symbol = 'a' + generator() % 26;
+    }
+    return string;
+  }
+
+  static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+  size_t size_;
+};
+
+// Round trip of SuffixTree::Save and MappedSuffixTree::Open: short random
+// texts over a few letters, the empty one among them, must answer Contains
+// like the tree they were saved from. Then a random text of size letters is
+// built, saved, mapped and queried.
+class SavedTreeBenchmark {
+ public:
+  SavedTreeBenchmark(size_t size, const std::string& path)
+      : size_(size), path_(path) {}
+
+  bool operator()() {
+    std::mt19937 generator(2);
+    for (int i = 0; i < NUMBER_OF_ROUND_TRIPS_; ++i) {
+      int letters = 1 + generator() % 3;
+      std::string text(i == 0 ? 0 : generator() % 40, 0);
+      for (auto&& symbol : text) {
+        symbol = 'a' + generator() % letters;
+      }
+      if (!IsRoundTripExact(text, letters, generator)) {
+        printf("round trip failed on \"%s\"\n", text.c_str());
+        return false;
+      }
+    }
+    printf("%d round trips exact\n", NUMBER_OF_ROUND_TRIPS_);
+
+    std::string text(size_, 0);
+    for (auto&& symbol : text) {
+      symbol = 'a' + generator() % 26;
+    }
+    auto start = std::chrono::steady_clock::now();
+    SuffixTree<DefaultChildren<TaskAlphabet>> tree(text, text.size());
+    double build_time = Seconds(start);
+    start = std::chrono::steady_clock::now();
+    bool is_saved = tree.Save(path_);
+    double save_time = Seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    MappedSuffixTree mapped_tree;
+    bool is_opened = is_saved && mapped_tree.Open(path_);
+    double open_time = Seconds(start);
+    if (!is_opened) {
+      printf("could not save to or open %s\n", path_.c_str());
+      return false;
+    }
+
+    start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (size_t i = 0; i < NUMBER_OF_PATTERNS_; ++i) {
+      found += mapped_tree.Contains(text.substr(
+          generator() % (size_ - PATTERN_SIZE_), PATTERN_SIZE_));
+    }
+    double query_time = Seconds(start);
+    printf("build %.2f s, save %.2f s, open %.3f ms, %.2f us per mapped "
+           "lookup (%zu found)\n",
+           build_time, save_time, 1e3 * open_time,
+           1e6 * query_time / NUMBER_OF_PATTERNS_, found);
+    return true;
+  }
+
+ private:
+  constexpr static const int NUMBER_OF_ROUND_TRIPS_ = 200;
+  constexpr static const size_t NUMBER_OF_PATTERNS_ = 100000;
+  constexpr static const size_t PATTERN_SIZE_ = 8;
+
+  bool IsRoundTripExact(const std::string& text, int letters,
+                        std::mt19937& generator) const {
+    SuffixTree<DefaultChildren<TaskAlphabet>> tree(text, text.size());
+    MappedSuffixTree mapped_tree;
+    if (!tree.Save(path_) || !mapped_tree.Open(path_)) {
+      return false;
+    }
+    for (int i = 0; i < 30; ++i) {
+      std::string pattern(generator() % 6, 0);
+      for (auto&& symbol : pattern) {
+        symbol = 'a' + generator() % (letters + 1);
+      }
+      bool is_found = text.find(pattern) != std::string::npos;
+      if (tree.Contains(pattern) != is_found ||
+          mapped_tree.Contains(pattern) != is_found) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+  size_t size_;
+  std::string path_;
+};
+
+int main(int argc, char** argv) {
+  const char* mode = argc > 1 ? argv[1] : "sorted";
+  size_t size = argc > 2 ? atol(argv[2]) : 100000;
+
+  if (strcmp(mode, "sorted") == 0) {
+    ChildStorageBenchmark<SortedArrayChildren<TaskAlphabet>> benchmark(size);
+    benchmark();
+  } else if (strcmp(mode, "dense") == 0) {
+    ChildStorageBenchmark<DenseTableChildren<TaskAlphabet>> benchmark(size);
+    benchmark();
+  } else if (strcmp(mode, "hash") == 0) {
+    ChildStorageBenchmark<HashTableChildren<TaskAlphabet>> benchmark(size);
+    benchmark();
+  } else if (strcmp(mode, "saved") == 0) {
+    SavedTreeBenchmark benchmark(size, argc > 3 ? argv[3] : "tree.bin");
+    if (!benchmark()) {
+      return 1;
+    }
+  } else {
+    fprintf(stderr, "unknown mode %s\n", mode);
+    return 1;
+  }
+
+  return 0;
+}
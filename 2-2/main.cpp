@@ -1,90 +1,501 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// Alphabets tell the child storage how to order letters: Index(letter) is
+// the rank of a letter, SIZE is the number of letters or 0 if the alphabet is
+// not bounded.
+
+// Letters of the task in ASCII order: '#' < '$' < 'a' < ... < 'z'.
+struct TaskAlphabet {
+  using Symbol = char;
+  static const int SIZE = 28;
+
+  static int Index(char letter) {
+    if (letter == '#') {
+      return 0;
+    }
+    if (letter == '$') {
+      return 1;
+    }
+    return letter - 'a' + 2;
+  }
+  static char Letter(int index) {
+    if (index == 0) {
+      return '#';
+    }
+    if (index == 1) {
+      return '$';
+    }
+    return static_cast<char>('a' + index - 2);
+  }
+};
+
+// Arbitrary bytes ordered as unsigned, so UTF-8 text is ordered by code
+// points.
+struct ByteAlphabet {
+  using Symbol = char;
+  static const int SIZE = 256;
+
+  static int Index(char letter) { return static_cast<unsigned char>(letter); }
+  static char Letter(int index) { return static_cast<char>(index); }
+};
+
+// Token ids of a tokenized text, a text is a std::u32string.
+struct IntegerAlphabet {
+  using Symbol = char32_t;
+  static const int SIZE = 0;
+
+  static uint32_t Index(char32_t letter) { return letter; }
+  static char32_t Letter(uint32_t index) { return index; }
+};
+
+// Child storage policies for SuffixTree. Each of them maps (vertex, letter)
+// to a child, returns -1 for a missing edge and enumerates children in
+// lexicographic order.
+
+// Per-vertex array of (letter, child) sorted by the index of the letter. Short
+// arrays are scanned linearly, long ones (only possible for big alphabets)
+// are searched by bisection.
+template <class Alphabet>
+class SortedArrayChildren {
+ public:
+  using Symbol = typename Alphabet::Symbol;
+
+  void Reserve(size_t number_of_vertices) {
+    children_.reserve(number_of_vertices);
+  }
+  void AddVertex() { children_.emplace_back(); }
+
+  int Find(int vertex, Symbol letter) const {
+    auto& children = children_[vertex];
+    if (children.size() <= LINEAR_SEARCH_LIMIT_) {
+      for (auto&& pair : children) {
+        if (pair.first == letter) {
+          return pair.second;
+        }
+      }
+      return -1;
+    }
+    auto it = LowerBound(children, letter);
+    return it != children.end() && it->first == letter ? it->second : -1;
+  }
+
+  void Set(int vertex, Symbol letter, int child) {
+    auto& children = children_[vertex];
+    auto it = LowerBound(children, letter);
+    if (it != children.end() && it->first == letter) {
+      it->second = child;
+    } else {
+      children.insert(it, std::make_pair(letter, child));
+    }
+  }
+
+  template <class Function>
+  void ForEach(int vertex, Function function) const {
+    for (auto&& pair : children_[vertex]) {
+      function(pair.first, pair.second);
+    }
+  }
+
+ private:
+  using Children = std::vector<std::pair<Symbol, int>>;
+
+  static const size_t LINEAR_SEARCH_LIMIT_ = 8;
+
+  template <class Vector>
+  static auto LowerBound(Vector& children, Symbol letter) {
+    return std::lower_bound(children.begin(), children.end(), letter,
+                            [](const std::pair<Symbol, int>& pair,
+                               Symbol letter) {
+                              return Alphabet::Index(pair.first) <
+                                     Alphabet::Index(letter);
+                            });
+  }
+
+  std::vector<Children> children_;
+};
+
+// One contiguous table with a slot for every letter of a bounded alphabet.
+template <class Alphabet>
+class DenseTableChildren {
+ public:
+  using Symbol = typename Alphabet::Symbol;
+  static_assert(Alphabet::SIZE > 0, "the alphabet must be bounded");
+
+  void Reserve(size_t number_of_vertices) {
+    table_.reserve(number_of_vertices * Alphabet::SIZE);
+  }
+  void AddVertex() { table_.resize(table_.size() + Alphabet::SIZE, -1); }
+
+  int Find(int vertex, Symbol letter) const {
+    return table_[Row(vertex) + Alphabet::Index(letter)];
+  }
+
+  void Set(int vertex, Symbol letter, int child) {
+    table_[Row(vertex) + Alphabet::Index(letter)] = child;
+  }
+
+  template <class Function>
+  void ForEach(int vertex, Function function) const {
+    const int* row = table_.data() + Row(vertex);
+    for (int i = 0; i < Alphabet::SIZE; ++i) {
+      if (row[i] != -1) {
+        function(Alphabet::Letter(i), row[i]);
+      }
+    }
+  }
+
+ private:
+  // in size_t: with 256 slots a row, an int offset overflows at 2^23
+  // vertices
+  static size_t Row(int vertex) {
+    return static_cast<size_t>(vertex) * Alphabet::SIZE;
+  }
+
+  std::vector<int> table_;
+};
+
+// Global open addressing table keyed by (vertex, letter).
+template <class Alphabet>
+class HashTableChildren {
+ public:
+  using Symbol = typename Alphabet::Symbol;
+
+  void AddVertex() {}
+  void Reserve(size_t number_of_vertices) {
+    size_t size = 16;
+    while (size < 4 * number_of_vertices) {
+      size *= 2;
+    }
+    if (size > keys_.size()) {
+      Rehash(size);
+    }
+  }
+
+  int Find(int vertex, Symbol letter) const {
+    uint64_t key = Key(vertex, Alphabet::Index(letter));
+    for (size_t slot = Slot(key); keys_[slot] != EMPTY_;
+         slot = (slot + 1) & (keys_.size() - 1)) {
+      if (keys_[slot] == key) {
+        return values_[slot];
+      }
+    }
+    return -1;
+  }
+
+  void Set(int vertex, Symbol letter, int child) {
+    Insert(Key(vertex, Alphabet::Index(letter)), child);
+  }
+
+  // probes every letter, so enumeration needs a bounded alphabet
+  template <class Function>
+  void ForEach(int vertex, Function function) const {
+    static_assert(Alphabet::SIZE > 0, "the alphabet must be bounded");
+    for (int i = 0; i < Alphabet::SIZE; ++i) {
+      int child = Find(vertex, Alphabet::Letter(i));
+      if (child != -1) {
+        function(Alphabet::Letter(i), child);
+      }
+    }
+  }
+
+ private:
+  static uint64_t Key(int vertex, uint32_t index) {
+    return (static_cast<uint64_t>(vertex) << 32) | index;
+  }
+  size_t Slot(uint64_t key) const {
+    return (key * 0x9E3779B97F4A7C15ULL >> 32) & (keys_.size() - 1);
+  }
+
+  void Insert(uint64_t key, int child) {
+    if (2 * (size_ + 1) > keys_.size()) {
+      Rehash(std::max<size_t>(16, 2 * keys_.size()));
+    }
+    size_t slot = Slot(key);
+    while (keys_[slot] != EMPTY_ && keys_[slot] != key) {
+      slot = (slot + 1) & (keys_.size() - 1);
+    }
+    if (keys_[slot] == EMPTY_) {
+      keys_[slot] = key;
+      ++size_;
+    }
+    values_[slot] = child;
+  }
+
+  void Rehash(size_t size) {
+    std::vector<uint64_t> keys(size, EMPTY_);
+    std::vector<int> values(size, -1);
+    keys.swap(keys_);
+    values.swap(values_);
+    size_ = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] != EMPTY_) {
+        Insert(keys[i], values[i]);
+      }
+    }
+  }
+
+  static const uint64_t EMPTY_ = ~uint64_t(0);
+
+  std::vector<uint64_t> keys_;
+  std::vector<int> values_;
+  size_t size_ = 0;
+};
+
+template <class Alphabet>
+const uint64_t HashTableChildren<Alphabet>::EMPTY_;
+
+// Child storage chosen by the size of the alphabet. For small alphabets
+// sorted arrays take half the memory of the dense table, bytes go to the hash
+// table (a table of 256 slots per vertex takes too much memory), unbounded
+// alphabets can not be enumerated by the hash table and go to sorted arrays
+// with bisection.
+template <class Alphabet>
+using DefaultChildren = typename std::conditional<
+    Alphabet::SIZE == 0 || Alphabet::SIZE <= TaskAlphabet::SIZE,
+    SortedArrayChildren<Alphabet>, HashTableChildren<Alphabet>>::type;
+
+// Depth-first traversal from root with an explicit stack, so long repeats in
+// the input do not overflow the call stack. A suffix tree has no cycles, so
+// no visited marks are needed. on_enter(vertex) is called in pre-order and
+// returns whether to descend into the vertex, on_exit(vertex) is called in
+// post-order. Children are visited in lexicographic order.
+template <class ChildStorage, class OnEnter, class OnExit>
+void TraverseDepthFirst(const ChildStorage& next_vertices, int root,
+                        OnEnter on_enter, OnExit on_exit) {
+  // an exit event for vertex v is stored as ~v
+  std::vector<int> stack = {root};
+  std::vector<int> children;
+  while (!stack.empty()) {
+    int vertex = stack.back();
+    stack.pop_back();
+    if (vertex < 0) {
+      on_exit(~vertex);
+      continue;
+    }
+    if (!on_enter(vertex)) {
+      continue;
+    }
+    stack.push_back(~vertex);
+
+    children.clear();
+    next_vertices.ForEach(vertex, [&children](auto, int child) {
+      children.push_back(child);
+    });
+    stack.insert(stack.end(), children.rbegin(), children.rend());
+  }
+}
+
+template <class ChildStorage, class Function>
+void ForEachPreOrder(const ChildStorage& next_vertices, int root,
+                     Function function) {
+  TraverseDepthFirst(
+      next_vertices, root,
+      [&function](int vertex) {
+        function(vertex);
+        return true;
+      },
+      [](int) {});
+}
+
+template <class ChildStorage, class Function>
+void ForEachPostOrder(const ChildStorage& next_vertices, int root,
+                      Function function) {
+  TraverseDepthFirst(
+      next_vertices, root, [](int) { return true; }, function);
+}
+
+template <class ChildStorage>
 class SuffixTree {
  public:
-  SuffixTree(const std::string& string, int first_part_size);
+  using Symbol = typename ChildStorage::Symbol;
+  using Text = std::basic_string<Symbol>;
+
+  // empty tree, the text is fed letter by letter with Append
+  explicit SuffixTree(int first_part_size = 0);
+  SuffixTree(const Text& string, int first_part_size);
+
+  // Ukkonen's algorithm is online: after every call the tree holds all the
+  // suffixes of the text read so far (as an implicit tree until a unique
+  // terminator arrives) and can be queried
+  void Append(Symbol letter);
+  // whether pattern occurs in the text read so far
+  bool Contains(const Text& pattern) const;
+  size_t Size() const { return string_.size(); }
+
+  // writes the tree in the format read by MappedSuffixTree, only for byte
+  // alphabets
+  bool Save(const std::string& path) const;
 
   void Print();
 
  private:
-  struct Vertex {
-    Vertex() = default;
+  // leaves grow together with the text, so their edges are open: right_ of a
+  // leaf is LEAF_END_ and the real end is the last letter read
+  static const int LEAF_END_ = 1 << 30;
+  static const int INITIAL_CAPACITY_ = 16;
 
-    Vertex(int left, int right, int parent)
-        : left_(left), right_(right), parent_(parent), suf_link_(0) {}
+  int EdgeEnd(int vertex) const {
+    return std::min(right_[vertex], position_in_string_ - 1);
+  }
 
-    int left_ = -1;
-    int right_ = -1;
-    int parent_ = -1;
-    int suf_link_ = 0;
-    std::map<char, int> next_vertices_;
-  };
+  // the auxiliary vertex 1 has an edge to the root by every letter, they are
+  // not stored, so the alphabet does not have to be known in advance
+  int Child(int vertex, Symbol letter) const {
+    return vertex == 1 ? 0 : next_vertices_.Find(vertex, letter);
+  }
 
-  void PrintDescriptionOfVertex(int current_vertex);
+  void Reserve(size_t capacity);
+  void InitializeVertex(int vertex, int left, int right, int parent);
 
-  void InsertLetter(char letter);
+  void PrintDescriptionOfVertex(int current_vertex);
 
-  std::vector<Vertex> tree_;
+  void InsertLetter(Symbol letter);
+
+  // left_, right_, parent_ and suf_link_ are consecutive slices of arena_,
+  // only vertices that were actually created are initialized, the arena
+  // doubles when the text outgrows it
+  std::unique_ptr<int[]> arena_;
+  int* left_ = nullptr;
+  int* right_ = nullptr;
+  int* parent_ = nullptr;
+  int* suf_link_ = nullptr;
+  size_t capacity_ = 0;
+  ChildStorage next_vertices_;
   int position_of_new_vertex_ = 2;
-  std::string string_;
+  Text string_;
   int first_part_size_;
   int position_in_string_ = 0;
   int vertex_of_current_suffix = 0;
   int position_on_edge = 0;
-  std::vector<bool> visited_;
 
   std::vector<int> vertex_numbers;
   int vertex_number = 1;
 };
 
-SuffixTree::SuffixTree(const std::string& string, int first_part_size) {
-  string_ = string;
-  first_part_size_ = first_part_size;
+template <class ChildStorage>
+SuffixTree<ChildStorage>::SuffixTree(int first_part_size)
+    : first_part_size_(first_part_size) {
+  Reserve(INITIAL_CAPACITY_);
+
+  InitializeVertex(0, -1, -1, -1);
+  InitializeVertex(1, -1, -1, -1);
+  suf_link_[0] = 1;
+
+  vertex_of_current_suffix = 0;
+  position_on_edge = 0;
+}
 
-  tree_.resize(2 * string_.size());
-  tree_[0] = Vertex();
+template <class ChildStorage>
+SuffixTree<ChildStorage>::SuffixTree(const Text& string,
+                                     int first_part_size)
+    : SuffixTree(first_part_size) {
+  string_.reserve(string.size());
+  Reserve(2 * string.size() + 2);
 
-  for (char symbol = 'a'; symbol <= 'z'; ++symbol) {
-    tree_[1].next_vertices_[symbol] = 0;
+  for (auto&& symbol : string) {
+    Append(symbol);
   }
-  tree_[1].next_vertices_['#'] = 0;
-  tree_[1].next_vertices_['$'] = 0;
-  tree_[0].suf_link_ = 1;
+}
 
-  for (size_t i = 2; i < tree_.size(); ++i) {
-    tree_[i].right_ = static_cast<int>(string_.size()) - 1;
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::Reserve(size_t capacity) {
+  if (capacity <= capacity_) {
+    return;
   }
 
-  vertex_of_current_suffix = 0;
-  position_on_edge = 0;
+  std::unique_ptr<int[]> arena(new int[4 * capacity]);
+  int* fields[] = {left_, right_, parent_, suf_link_};
+  for (int i = 0; i < 4; ++i) {
+    if (fields[i] != nullptr) {
+      std::copy(fields[i], fields[i] + position_of_new_vertex_,
+                arena.get() + i * capacity);
+    }
+  }
+
+  arena_ = std::move(arena);
+  capacity_ = capacity;
+  left_ = arena_.get();
+  right_ = left_ + capacity;
+  parent_ = right_ + capacity;
+  suf_link_ = parent_ + capacity;
+  next_vertices_.Reserve(capacity);
+}
+
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::Append(Symbol letter) {
+  // a text of n letters has at most 2n + 2 vertices with the auxiliary one
+  size_t required = 2 * string_.size() + 4;
+  if (required > capacity_) {
+    Reserve(std::max(required, 2 * capacity_));
+  }
 
-  for (auto&& symbol : string_) {
-    InsertLetter(symbol);
-    ++position_in_string_;
+  string_.push_back(letter);
+  InsertLetter(letter);
+  ++position_in_string_;
+}
+
+template <class ChildStorage>
+bool SuffixTree<ChildStorage>::Contains(const Text& pattern) const {
+  int current_vertex = 0;
+  size_t matched = 0;
+  while (matched < pattern.size()) {
+    current_vertex = next_vertices_.Find(current_vertex, pattern[matched]);
+    if (current_vertex == -1) {
+      return false;
+    }
+    int end = EdgeEnd(current_vertex);
+    for (int i = left_[current_vertex]; i <= end && matched < pattern.size();
+         ++i, ++matched) {
+      if (string_[i] != pattern[matched]) {
+        return false;
+      }
+    }
   }
+  return true;
 }
 
-void SuffixTree::InsertLetter(char letter) {
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::InitializeVertex(int vertex, int left,
+                                                int right, int parent) {
+  left_[vertex] = left;
+  right_[vertex] = right;
+  parent_[vertex] = parent;
+  suf_link_[vertex] = 0;
+  next_vertices_.AddVertex();
+}
+
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::InsertLetter(Symbol letter) {
   while (true) {
-    if (tree_[vertex_of_current_suffix].right_ < position_on_edge) {
-      if (tree_[vertex_of_current_suffix].next_vertices_.find(letter) ==
-          tree_[vertex_of_current_suffix].next_vertices_.end()) {
-        tree_[vertex_of_current_suffix].next_vertices_[letter] =
-            position_of_new_vertex_;
-        tree_[position_of_new_vertex_].left_ = position_in_string_;
-        tree_[position_of_new_vertex_].parent_ = vertex_of_current_suffix;
+    if (right_[vertex_of_current_suffix] < position_on_edge) {
+      int next_vertex = Child(vertex_of_current_suffix, letter);
+      if (next_vertex == -1) {
+        next_vertices_.Set(vertex_of_current_suffix, letter,
+                           position_of_new_vertex_);
+        InitializeVertex(position_of_new_vertex_, position_in_string_,
+                         LEAF_END_, vertex_of_current_suffix);
         ++position_of_new_vertex_;
 
-        vertex_of_current_suffix = tree_[vertex_of_current_suffix].suf_link_;
-        position_on_edge = tree_[vertex_of_current_suffix].right_ + 1;
+        vertex_of_current_suffix = suf_link_[vertex_of_current_suffix];
+        position_on_edge = right_[vertex_of_current_suffix] + 1;
 
         continue;
       }
-      vertex_of_current_suffix =
-          tree_[vertex_of_current_suffix].next_vertices_[letter];
-      position_on_edge = tree_[vertex_of_current_suffix].left_;
+      vertex_of_current_suffix = next_vertex;
+      position_on_edge = left_[vertex_of_current_suffix];
     }
 
     if (position_on_edge == -1 || letter == string_[position_on_edge]) {
@@ -92,79 +503,253 @@ void SuffixTree::InsertLetter(char letter) {
       break;
     }
 
-    tree_[position_of_new_vertex_] =
-        Vertex(tree_[vertex_of_current_suffix].left_, position_on_edge - 1,
-               tree_[vertex_of_current_suffix].parent_);
-    tree_[position_of_new_vertex_].next_vertices_[string_[position_on_edge]] =
-        vertex_of_current_suffix;
-    tree_[position_of_new_vertex_].next_vertices_[letter] =
-        position_of_new_vertex_ + 1;
-    tree_[position_of_new_vertex_ + 1].left_ = position_in_string_;
-    tree_[position_of_new_vertex_ + 1].parent_ = position_of_new_vertex_;
-
-    tree_[vertex_of_current_suffix].left_ = position_on_edge;
-    tree_[vertex_of_current_suffix].parent_ = position_of_new_vertex_;
-    tree_[tree_[position_of_new_vertex_].parent_]
-        .next_vertices_[string_[tree_[position_of_new_vertex_].left_]] =
-        position_of_new_vertex_;
+    InitializeVertex(position_of_new_vertex_, left_[vertex_of_current_suffix],
+                     position_on_edge - 1, parent_[vertex_of_current_suffix]);
+    next_vertices_.Set(position_of_new_vertex_, string_[position_on_edge],
+                       vertex_of_current_suffix);
+    next_vertices_.Set(position_of_new_vertex_, letter,
+                       position_of_new_vertex_ + 1);
+    InitializeVertex(position_of_new_vertex_ + 1, position_in_string_,
+                     LEAF_END_, position_of_new_vertex_);
+
+    left_[vertex_of_current_suffix] = position_on_edge;
+    parent_[vertex_of_current_suffix] = position_of_new_vertex_;
+    next_vertices_.Set(parent_[position_of_new_vertex_],
+                       string_[left_[position_of_new_vertex_]],
+                       position_of_new_vertex_);
 
     position_of_new_vertex_ += 2;
 
-    vertex_of_current_suffix =
-        tree_[tree_[position_of_new_vertex_ - 2].parent_].suf_link_;
-    position_on_edge = tree_[position_of_new_vertex_ - 2].left_;
+    vertex_of_current_suffix = suf_link_[parent_[position_of_new_vertex_ - 2]];
+    position_on_edge = left_[position_of_new_vertex_ - 2];
 
-    while (position_on_edge <= tree_[position_of_new_vertex_ - 2].right_) {
-      vertex_of_current_suffix = tree_[vertex_of_current_suffix]
-                                     .next_vertices_[string_[position_on_edge]];
-      position_on_edge += tree_[vertex_of_current_suffix].right_ -
-                          tree_[vertex_of_current_suffix].left_ + 1;
+    while (position_on_edge <= right_[position_of_new_vertex_ - 2]) {
+      vertex_of_current_suffix =
+          Child(vertex_of_current_suffix, string_[position_on_edge]);
+      position_on_edge += right_[vertex_of_current_suffix] -
+                          left_[vertex_of_current_suffix] + 1;
     }
 
-    if (position_on_edge == tree_[position_of_new_vertex_ - 2].right_ + 1) {
-      tree_[position_of_new_vertex_ - 2].suf_link_ = vertex_of_current_suffix;
+    if (position_on_edge == right_[position_of_new_vertex_ - 2] + 1) {
+      suf_link_[position_of_new_vertex_ - 2] = vertex_of_current_suffix;
     } else {
-      tree_[position_of_new_vertex_ - 2].suf_link_ = position_of_new_vertex_;
+      suf_link_[position_of_new_vertex_ - 2] = position_of_new_vertex_;
     }
 
     position_on_edge =
-        tree_[vertex_of_current_suffix].right_ -
-        (position_on_edge - tree_[position_of_new_vertex_ - 2].right_) + 2;
+        right_[vertex_of_current_suffix] -
+        (position_on_edge - right_[position_of_new_vertex_ - 2]) + 2;
   }
 }
 
-void SuffixTree::Print() {
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::Print() {
   printf("%d\n", position_of_new_vertex_ - 1);
-  visited_.resize(position_of_new_vertex_);
   vertex_numbers.resize(position_of_new_vertex_);
   
   // from the task description we should traverse tree in lexicographical order(DFS)
-  PrintDescriptionOfVertex(0);
+  ForEachPreOrder(next_vertices_, 0, [this](int current_vertex) {
+    PrintDescriptionOfVertex(current_vertex);
+  });
 }
 
-void SuffixTree::PrintDescriptionOfVertex(int current_vertex) {
-  visited_[current_vertex] = true;
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::PrintDescriptionOfVertex(int current_vertex) {
   if (current_vertex != 0) {
     vertex_numbers[current_vertex] = vertex_number;
     ++vertex_number;
-    printf("%d ", vertex_numbers[tree_[current_vertex].parent_]);
+    printf("%d ", vertex_numbers[parent_[current_vertex]]);
 
-    int string_index = (tree_[current_vertex].left_ < first_part_size_) ? 0 : 1;
+    int string_index = (left_[current_vertex] < first_part_size_) ? 0 : 1;
     printf("%d ", string_index);
     printf("%d ",
-           tree_[current_vertex].left_ - first_part_size_ * string_index);
+           left_[current_vertex] - first_part_size_ * string_index);
     printf("%d\n",
-           (!string_index && tree_[current_vertex].right_ >= first_part_size_)
+           (!string_index && EdgeEnd(current_vertex) >= first_part_size_)
                ? first_part_size_
-               : tree_[current_vertex].right_ + 1 -
-                     first_part_size_ * string_index);
+               : EdgeEnd(current_vertex) + 1 - first_part_size_ * string_index);
+  }
+}
+
+// Binary layout of a saved suffix tree, all integers are 32-bit in the byte
+// order of the machine that wrote the file:
+//   header
+//   left[number_of_vertices], right[number_of_vertices]  edge of a vertex
+//   child_begin[number_of_vertices + 1]  children of v are child_begin[v] ..
+//                                        child_begin[v + 1] - 1
+//   child_vertex[number_of_edges]
+//   child_letter[number_of_edges]  first letters of the edges, sorted as
+//                                  unsigned bytes
+//   text[text_size]
+// The auxiliary vertex 1 is stored without children.
+struct SuffixTreeFileHeader {
+  static const uint32_t MAGIC = 0x45525453;  // "STRE"
+
+  uint32_t magic = MAGIC;
+  uint32_t number_of_vertices = 0;
+  uint32_t number_of_edges = 0;
+  uint32_t text_size = 0;
+};
+
+// count elements of data, nothing is passed to fwrite for an empty array,
+// whose data() may be null
+template <class Element>
+bool WriteArray(const Element* data, size_t count, FILE* file) {
+  return count == 0 || fwrite(data, sizeof(Element), count, file) == count;
+}
+
+template <class ChildStorage>
+bool SuffixTree<ChildStorage>::Save(const std::string& path) const {
+  static_assert(sizeof(Symbol) == 1, "only byte alphabets are saved");
+
+  SuffixTreeFileHeader header;
+  header.number_of_vertices = position_of_new_vertex_;
+  header.number_of_edges = position_of_new_vertex_ - 2;
+  header.text_size = string_.size();
+
+  std::vector<int32_t> right(position_of_new_vertex_);
+  std::vector<int32_t> child_begin = {0};
+  std::vector<int32_t> child_vertex;
+  std::vector<char> child_letter;
+  child_vertex.reserve(header.number_of_edges);
+  child_letter.reserve(header.number_of_edges);
+  for (int vertex = 0; vertex < position_of_new_vertex_; ++vertex) {
+    right[vertex] = EdgeEnd(vertex);
+    if (vertex != 1) {
+      next_vertices_.ForEach(vertex, [&](Symbol letter, int child) {
+        child_vertex.push_back(child);
+        child_letter.push_back(letter);
+      });
+    }
+    child_begin.push_back(child_vertex.size());
+  }
+
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool is_written =
+      WriteArray(&header, 1, file) &&
+      WriteArray(left_, position_of_new_vertex_, file) &&
+      WriteArray(right.data(), right.size(), file) &&
+      WriteArray(child_begin.data(), child_begin.size(), file) &&
+      WriteArray(child_vertex.data(), child_vertex.size(), file) &&
+      WriteArray(child_letter.data(), child_letter.size(), file) &&
+      WriteArray(string_.data(), string_.size(), file);
+  return fclose(file) == 0 && is_written;
+}
+
+// Read-only suffix tree mapped straight from a file written by
+// SuffixTree::Save, so a query service starts without rebuilding the tree.
+class MappedSuffixTree {
+ public:
+  MappedSuffixTree() = default;
+  MappedSuffixTree(const MappedSuffixTree&) = delete;
+  MappedSuffixTree& operator=(const MappedSuffixTree&) = delete;
+  ~MappedSuffixTree() { Close(); }
+
+  bool Open(const std::string& path);
+  void Close();
+
+  int NumberOfVertices() const { return header_->number_of_vertices; }
+  // child of vertex by the first letter of its edge, -1 if there is none
+  int Child(int vertex, char letter) const;
+  bool Contains(const std::string& pattern) const;
+
+ private:
+  void* data_ = nullptr;
+  size_t size_ = 0;
+
+  const SuffixTreeFileHeader* header_ = nullptr;
+  const int32_t* left_ = nullptr;
+  const int32_t* right_ = nullptr;
+  const int32_t* child_begin_ = nullptr;
+  const int32_t* child_vertex_ = nullptr;
+  const char* child_letter_ = nullptr;
+  const char* text_ = nullptr;
+};
+
+bool MappedSuffixTree::Open(const std::string& path) {
+  Close();
+
+  int descriptor = open(path.c_str(), O_RDONLY);
+  if (descriptor == -1) {
+    return false;
+  }
+  struct stat file_status;
+  if (fstat(descriptor, &file_status) != 0 ||
+      static_cast<size_t>(file_status.st_size) < sizeof(SuffixTreeFileHeader)) {
+    close(descriptor);
+    return false;
+  }
+  size_ = file_status.st_size;
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+  if (data_ == MAP_FAILED) {
+    data_ = nullptr;
+    return false;
+  }
+
+  header_ = static_cast<const SuffixTreeFileHeader*>(data_);
+  size_t vertices = header_->number_of_vertices;
+  size_t edges = header_->number_of_edges;
+  size_t expected_size = sizeof(SuffixTreeFileHeader) +
+                         sizeof(int32_t) * (3 * vertices + 1 + edges) + edges +
+                         header_->text_size;
+  if (header_->magic != SuffixTreeFileHeader::MAGIC || size_ != expected_size) {
+    Close();
+    return false;
   }
 
-  for (auto&& pair : tree_[current_vertex].next_vertices_) {
-    if (!visited_[pair.second]) {
-      PrintDescriptionOfVertex(pair.second);
+  left_ = reinterpret_cast<const int32_t*>(header_ + 1);
+  right_ = left_ + vertices;
+  child_begin_ = right_ + vertices;
+  child_vertex_ = child_begin_ + vertices + 1;
+  child_letter_ = reinterpret_cast<const char*>(child_vertex_ + edges);
+  text_ = child_letter_ + edges;
+  return true;
+}
+
+void MappedSuffixTree::Close() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  header_ = nullptr;
+}
+
+int MappedSuffixTree::Child(int vertex, char letter) const {
+  const char* begin = child_letter_ + child_begin_[vertex];
+  const char* end = child_letter_ + child_begin_[vertex + 1];
+  const char* it =
+      std::lower_bound(begin, end, letter, [](char left, char right) {
+        return static_cast<unsigned char>(left) <
+               static_cast<unsigned char>(right);
+      });
+  if (it == end || *it != letter) {
+    return -1;
+  }
+  return child_vertex_[it - child_letter_];
+}
+
+bool MappedSuffixTree::Contains(const std::string& pattern) const {
+  int current_vertex = 0;
+  size_t matched = 0;
+  while (matched < pattern.size()) {
+    current_vertex = Child(current_vertex, pattern[matched]);
+    if (current_vertex == -1) {
+      return false;
+    }
+    for (int i = left_[current_vertex];
+         i <= right_[current_vertex] && matched < pattern.size();
+         ++i, ++matched) {
+      if (text_[i] != pattern[matched]) {
+        return false;
+      }
     }
   }
+  return true;
 }
 
 int main() {
@@ -175,7 +760,8 @@ int main() {
 
   second_string = first_string + second_string;
 
-  SuffixTree tree(second_string, first_string.size());
+  SuffixTree<DefaultChildren<TaskAlphabet>> tree(second_string,
+                                                 first_string.size());
 
   tree.Print();
 
@@ -0,0 +1,93 @@
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// the classes of the solution, its main is renamed out of the way
+#define main SolveFromInput
+#include "main.cpp"
+#undef main
+
+// Builds the tree of the task, s$t#, over 'a'..'z' with one child storage
+// policy (the common substring counts are part of the build) and answers
+// single k-th common substring queries for random k. The peak memory of the
+// process is printed too, so a policy is measured in a run of its own.
+//
+// g++ -std=c++17 -O2 -pthread bench.cpp -o bench &&
+//     ./bench sorted|dense|hash [size]
+template <class ChildStorage>
+class ChildStorageBenchmark {
+ public:
+  explicit ChildStorageBenchmark(size_t size) : size_(size) {}
+
+  void operator()() {
+    std::mt19937_64 generator(1);
+    std::string first_string = RandomString(generator);
+    std::string second_string = RandomString(generator);
+
+    auto start = std::chrono::steady_clock::now();
+    SuffixTree<ChildStorage> tree(first_string + '$' + second_string + '#',
+                                  first_string.size() + 1);
+    double build_time = Seconds(start);
+
+    long long number_of_substrings = tree.NumberOfCommonSubstrings();
+    start = std::chrono::steady_clock::now();
+    long long total_length = 0;
+    for (size_t i = 0; i < NUMBER_OF_QUERIES_; ++i) {
+      long long k = 1 + generator() % number_of_substrings;
+      total_length += tree.FindKthStatistic(k).length;
+    }
+    double query_time = Seconds(start);
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("build %.3f s, %.0f ns per query (mean length %.1f), peak %ld MB\n",
+           build_time, 1e9 * query_time / NUMBER_OF_QUERIES_,
+           double(total_length) / NUMBER_OF_QUERIES_, usage.ru_maxrss / 1024);
+  }
+
+ private:
+  constexpr static const size_t NUMBER_OF_QUERIES_ = 100000;
+
+  std::string RandomString(std::mt19937_64& generator) const {
+    std::string string(size_, 0);
+    for (auto&& symbol : string) {
+      symbol = 'a' + generator() % 26;
+    }
+    return string;
+  }
+
+  static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+  size_t size_;
+};
+
+int main(int argc, char** argv) {
+  const char* policy = argc > 1 ? argv[1] : "sorted";
+  size_t size = argc > 2 ? atol(argv[2]) : 100000;
+
+  if (strcmp(policy, "sorted") == 0) {
+    ChildStorageBenchmark<SortedArrayChildren<TaskAlphabet>> benchmark(size);
+    benchmark();
+  } else if (strcmp(policy, "dense") == 0) {
+    ChildStorageBenchmark<DenseTableChildren<TaskAlphabet>> benchmark(size);
+    benchmark();
+  } else if (strcmp(policy, "hash") == 0) {
+    ChildStorageBenchmark<HashTableChildren<TaskAlphabet>> benchmark(size);
+    benchmark();
+  } else {
+    fprintf(stderr, "unknown policy %s\n", policy);
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,71 +1,390 @@
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
-#include <map>
-#include <stack>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// Alphabets tell the child storage how to order letters: Index(letter) is
+// the rank of a letter, SIZE is the number of letters or 0 if the alphabet is
+// not bounded.
+
+// Letters of the task in ASCII order: '#' < '$' < 'a' < ... < 'z'.
+struct TaskAlphabet {
+  using Symbol = char;
+  static const int SIZE = 28;
+
+  static int Index(char letter) {
+    if (letter == '#') {
+      return 0;
+    }
+    if (letter == '$') {
+      return 1;
+    }
+    return letter - 'a' + 2;
+  }
+  static char Letter(int index) {
+    if (index == 0) {
+      return '#';
+    }
+    if (index == 1) {
+      return '$';
+    }
+    return static_cast<char>('a' + index - 2);
+  }
+};
+
+// Arbitrary bytes ordered as unsigned, so UTF-8 text is ordered by code
+// points.
+struct ByteAlphabet {
+  using Symbol = char;
+  static const int SIZE = 256;
+
+  static int Index(char letter) { return static_cast<unsigned char>(letter); }
+  static char Letter(int index) { return static_cast<char>(index); }
+};
+
+// Symbols of GeneralizedSuffixTree: the bytes of the documents and a
+// negative terminator after each of them. Not bounded, so the children are
+// never enumerated by letter.
+struct IntegerAlphabet {
+  using Symbol = int;
+  static const int SIZE = 0;
+
+  static uint32_t Index(int letter) { return static_cast<uint32_t>(letter); }
+  static int Letter(uint32_t index) { return static_cast<int>(index); }
+};
+
+// Child storage policies for SuffixTree. Each of them maps (vertex, letter)
+// to a child, returns -1 for a missing edge and enumerates children in
+// lexicographic order.
+
+// Per-vertex array of (letter, child) kept sorted by the index of the letter,
+// scanned linearly.
+template <class Alphabet>
+class SortedArrayChildren {
+ public:
+  using Symbol = typename Alphabet::Symbol;
+
+  void Reserve(size_t number_of_vertices) {
+    children_.reserve(number_of_vertices);
+  }
+  void AddVertex() { children_.emplace_back(); }
+
+  int Find(int vertex, Symbol letter) const {
+    for (auto&& pair : children_[vertex]) {
+      if (pair.first == letter) {
+        return pair.second;
+      }
+    }
+    return -1;
+  }
+
+  void Set(int vertex, Symbol letter, int child) {
+    auto& children = children_[vertex];
+    size_t i = 0;
+    while (i < children.size() &&
+           Alphabet::Index(children[i].first) < Alphabet::Index(letter)) {
+      ++i;
+    }
+    if (i < children.size() && children[i].first == letter) {
+      children[i].second = child;
+    } else {
+      children.insert(children.begin() + i, std::make_pair(letter, child));
+    }
+  }
+
+  template <class Function>
+  void ForEach(int vertex, Function function) const {
+    for (auto&& pair : children_[vertex]) {
+      function(pair.first, pair.second);
+    }
+  }
+
+ private:
+  std::vector<std::vector<std::pair<Symbol, int>>> children_;
+};
+
+// One contiguous table with a slot for every letter of a bounded alphabet.
+template <class Alphabet>
+class DenseTableChildren {
+ public:
+  using Symbol = typename Alphabet::Symbol;
+  static_assert(Alphabet::SIZE > 0, "the alphabet must be bounded");
+
+  void Reserve(size_t number_of_vertices) {
+    table_.reserve(number_of_vertices * Alphabet::SIZE);
+  }
+  void AddVertex() { table_.resize(table_.size() + Alphabet::SIZE, -1); }
+
+  int Find(int vertex, Symbol letter) const {
+    return table_[Row(vertex) + Alphabet::Index(letter)];
+  }
+
+  void Set(int vertex, Symbol letter, int child) {
+    table_[Row(vertex) + Alphabet::Index(letter)] = child;
+  }
+
+  template <class Function>
+  void ForEach(int vertex, Function function) const {
+    const int* row = table_.data() + Row(vertex);
+    for (int i = 0; i < Alphabet::SIZE; ++i) {
+      if (row[i] != -1) {
+        function(Alphabet::Letter(i), row[i]);
+      }
+    }
+  }
+
+ private:
+  // in size_t: with 256 slots a row, an int offset overflows at 2^23
+  // vertices
+  static size_t Row(int vertex) {
+    return static_cast<size_t>(vertex) * Alphabet::SIZE;
+  }
+
+  std::vector<int> table_;
+};
+
+// Global open addressing table keyed by (vertex, letter).
+template <class Alphabet>
+class HashTableChildren {
+ public:
+  using Symbol = typename Alphabet::Symbol;
+
+  void AddVertex() {}
+  void Reserve(size_t number_of_vertices) {
+    size_t size = 16;
+    while (size < 2 * number_of_vertices) {
+      size *= 2;
+    }
+    if (size > keys_.size()) {
+      Rehash(size);
+    }
+  }
+
+  int Find(int vertex, Symbol letter) const {
+    uint64_t key = Key(vertex, Alphabet::Index(letter));
+    for (size_t slot = Slot(key); keys_[slot] != EMPTY_;
+         slot = (slot + 1) & (keys_.size() - 1)) {
+      if (keys_[slot] == key) {
+        return values_[slot];
+      }
+    }
+    return -1;
+  }
+
+  void Set(int vertex, Symbol letter, int child) {
+    Insert(Key(vertex, Alphabet::Index(letter)), child);
+  }
+
+  // probes every letter, so enumeration needs a bounded alphabet
+  template <class Function>
+  void ForEach(int vertex, Function function) const {
+    static_assert(Alphabet::SIZE > 0, "the alphabet must be bounded");
+    for (int i = 0; i < Alphabet::SIZE; ++i) {
+      int child = Find(vertex, Alphabet::Letter(i));
+      if (child != -1) {
+        function(Alphabet::Letter(i), child);
+      }
+    }
+  }
+
+ private:
+  static uint64_t Key(int vertex, uint32_t index) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(vertex)) << 32) |
+           index;
+  }
+  size_t Slot(uint64_t key) const {
+    return (key * 0x9E3779B97F4A7C15ULL >> 32) & (keys_.size() - 1);
+  }
+
+  void Insert(uint64_t key, int child) {
+    if (2 * (size_ + 1) > keys_.size()) {
+      Rehash(std::max<size_t>(16, 2 * keys_.size()));
+    }
+    size_t slot = Slot(key);
+    while (keys_[slot] != EMPTY_ && keys_[slot] != key) {
+      slot = (slot + 1) & (keys_.size() - 1);
+    }
+    if (keys_[slot] == EMPTY_) {
+      keys_[slot] = key;
+      ++size_;
+    }
+    values_[slot] = child;
+  }
+
+  void Rehash(size_t size) {
+    std::vector<uint64_t> keys(size, EMPTY_);
+    std::vector<int> values(size, -1);
+    keys.swap(keys_);
+    values.swap(values_);
+    size_ = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] != EMPTY_) {
+        Insert(keys[i], values[i]);
+      }
+    }
+  }
+
+  static const uint64_t EMPTY_ = ~uint64_t(0);
+
+  std::vector<uint64_t> keys_;
+  std::vector<int> values_;
+  size_t size_ = 0;
+};
+
+template <class Alphabet>
+const uint64_t HashTableChildren<Alphabet>::EMPTY_;
+
+// Depth-first traversal from root with an explicit stack, so long repeats in
+// the input do not overflow the call stack. A suffix tree has no cycles, so
+// no visited marks are needed. on_enter(vertex) is called in pre-order and
+// returns whether to descend into the vertex, on_exit(vertex) is called in
+// post-order. Children are visited in lexicographic order.
+template <class ChildStorage, class OnEnter, class OnExit>
+void TraverseDepthFirst(const ChildStorage& next_vertices, int root,
+                        OnEnter on_enter, OnExit on_exit) {
+  // an exit event for vertex v is stored as ~v
+  std::vector<int> stack = {root};
+  std::vector<int> children;
+  while (!stack.empty()) {
+    int vertex = stack.back();
+    stack.pop_back();
+    if (vertex < 0) {
+      on_exit(~vertex);
+      continue;
+    }
+    if (!on_enter(vertex)) {
+      continue;
+    }
+    stack.push_back(~vertex);
+
+    children.clear();
+    next_vertices.ForEach(vertex, [&children](auto, int child) {
+      children.push_back(child);
+    });
+    stack.insert(stack.end(), children.rbegin(), children.rend());
+  }
+}
+
+template <class ChildStorage, class Function>
+void ForEachPreOrder(const ChildStorage& next_vertices, int root,
+                     Function function) {
+  TraverseDepthFirst(
+      next_vertices, root,
+      [&function](int vertex) {
+        function(vertex);
+        return true;
+      },
+      [](int) {});
+}
+
+template <class ChildStorage, class Function>
+void ForEachPostOrder(const ChildStorage& next_vertices, int root,
+                      Function function) {
+  TraverseDepthFirst(
+      next_vertices, root, [](int) { return true; }, function);
+}
+
+template <class ChildStorage>
 class SuffixTree {
  public:
+  static_assert(std::is_same<typename ChildStorage::Symbol, char>::value,
+                "the strings are strings of bytes");
+
+  // occurrence of a substring in the string passed to the constructor
+  struct SubstringPosition {
+    int offset = 0;
+    int length = 0;
+  };
+
   SuffixTree(const std::string& string, int first_part_size);
 
-  std::string FindKthStatistic(long long k);
+  long long NumberOfCommonSubstrings() const { return common_substrings_[0]; }
+  // k-th in lexicographic order common substring, length 0 if there is none
+  SubstringPosition FindKthStatistic(long long k) const;
+  // answers for a batch of k sorted in non-decreasing order, found in one
+  // traversal of the tree
+  std::vector<SubstringPosition> FindKthStatistics(
+      const std::vector<long long>& sorted_k) const;
+  // the same, the batch is split into contiguous parts answered by separate
+  // threads (all queries are const and share the precomputed counts)
+  std::vector<SubstringPosition> FindKthStatistics(
+      const std::vector<long long>& sorted_k, int number_of_threads) const;
+
+  // longest common substring of the two strings, length 0 if there is none
+  SubstringPosition LongestCommonSubstring() const;
+  // result[i] is the length of the longest prefix of query[i..] that occurs
+  // in the indexed string, O(|query|) with suffix links
+  std::vector<int> MatchingStatistics(const std::string& query) const;
 
  private:
-  struct Vertex {
-    Vertex() = default;
-
-    Vertex(int left, int right, int parent)
-        : left_(left), right_(right), parent_(parent), suf_link_(0) {}
-
-    int left_ = -1;
-    int right_ = -1;
-    int parent_ = -1;
-    int suf_link_ = 0;
-    std::map<char, int> next_vertices_;
-    bool has_first_terminal = false;
-    bool has_second_terminal = false;
+  enum TerminalMask : unsigned char {
+    FIRST_TERMINAL_ = 1,
+    SECOND_TERMINAL_ = 2,
+    BOTH_TERMINALS_ = 3,
   };
 
-  void MarkSubstringVertices();
-  void UpdateTerminalInfo(int current_vertex);
-  void FillResultString(int current_vertex);
+  void InitializeVertex(int vertex, int left, int right, int parent);
+
+  void CountCommonSubstrings();
+  void AnswerQueries(const long long* begin, const long long* end,
+                     SubstringPosition* result) const;
+
+  int EdgeLength(int vertex) const {
+    return right_[vertex] - left_[vertex] + 1;
+  }
+
+  // the auxiliary vertex 1 has an edge to the root by every letter, they are
+  // not stored, so the letters are those of the alphabet of ChildStorage
+  // only: any byte with ByteAlphabet
+  int Child(int vertex, char letter) const {
+    return vertex == 1 ? 0 : next_vertices_.Find(vertex, letter);
+  }
 
   void InsertLetter(char letter);
 
-  std::vector<Vertex> tree_;
+  // left_, right_, parent_ and suf_link_ are consecutive slices of arena_,
+  // only vertices that were actually created are initialized
+  std::unique_ptr<int[]> arena_;
+  int* left_ = nullptr;
+  int* right_ = nullptr;
+  int* parent_ = nullptr;
+  int* suf_link_ = nullptr;
+  ChildStorage next_vertices_;
+  // which strings have a terminal leaf in the subtree of a vertex
+  std::vector<unsigned char> terminal_mask_;
+  // number of common substrings ending on edges of the subtree of a vertex,
+  // the edge into the vertex included
+  std::vector<long long> common_substrings_;
   int position_of_new_vertex_ = 2;
   std::string string_;
   int first_part_size_;
   int position_in_string_ = 0;
   int vertex_of_current_suffix = 0;
   int position_on_edge = 0;
-  std::vector<bool> visited_;
-
-  std::vector<int> vertex_numbers;
-  int vertex_number = 1;
-
-  long long k_ = 0;
-  long long counter_ = 0;
-  std::string kth_statistic_;
 };
 
-SuffixTree::SuffixTree(const std::string& string, int first_part_size) {
+template <class ChildStorage>
+SuffixTree<ChildStorage>::SuffixTree(const std::string& string,
+                                     int first_part_size) {
   string_ = string;
   first_part_size_ = first_part_size;
 
-  tree_.resize(2 * string_.size());
-  tree_[0] = Vertex();
-
-  for (char symbol = 'a'; symbol <= 'z'; ++symbol) {
-    tree_[1].next_vertices_[symbol] = 0;
-  }
-  tree_[1].next_vertices_['#'] = 0;
-  tree_[1].next_vertices_['$'] = 0;
-  tree_[0].suf_link_ = 1;
+  size_t capacity = 2 * string_.size();
+  arena_.reset(new int[4 * capacity]);
+  left_ = arena_.get();
+  right_ = left_ + capacity;
+  parent_ = right_ + capacity;
+  suf_link_ = parent_ + capacity;
+  next_vertices_.Reserve(capacity);
 
-  for (size_t i = 2; i < tree_.size(); ++i) {
-    tree_[i].right_ = static_cast<int>(string_.size()) - 1;
-  }
+  InitializeVertex(0, -1, -1, -1);
+  InitializeVertex(1, -1, -1, -1);
+  suf_link_[0] = 1;
 
   vertex_of_current_suffix = 0;
   position_on_edge = 0;
@@ -74,27 +393,40 @@ SuffixTree::SuffixTree(const std::string& string, int first_part_size) {
     InsertLetter(symbol);
     ++position_in_string_;
   }
+
+  CountCommonSubstrings();
+}
+
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::InitializeVertex(int vertex, int left,
+                                                int right, int parent) {
+  left_[vertex] = left;
+  right_[vertex] = right;
+  parent_[vertex] = parent;
+  suf_link_[vertex] = 0;
+  next_vertices_.AddVertex();
 }
 
-void SuffixTree::InsertLetter(char letter) {
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::InsertLetter(char letter) {
   while (true) {
-    if (tree_[vertex_of_current_suffix].right_ < position_on_edge) {
-      if (tree_[vertex_of_current_suffix].next_vertices_.find(letter) ==
-          tree_[vertex_of_current_suffix].next_vertices_.end()) {
-        tree_[vertex_of_current_suffix].next_vertices_[letter] =
-            position_of_new_vertex_;
-        tree_[position_of_new_vertex_].left_ = position_in_string_;
-        tree_[position_of_new_vertex_].parent_ = vertex_of_current_suffix;
+    if (right_[vertex_of_current_suffix] < position_on_edge) {
+      int next_vertex = Child(vertex_of_current_suffix, letter);
+      if (next_vertex == -1) {
+        next_vertices_.Set(vertex_of_current_suffix, letter,
+                           position_of_new_vertex_);
+        InitializeVertex(position_of_new_vertex_, position_in_string_,
+                         static_cast<int>(string_.size()) - 1,
+                         vertex_of_current_suffix);
         ++position_of_new_vertex_;
 
-        vertex_of_current_suffix = tree_[vertex_of_current_suffix].suf_link_;
-        position_on_edge = tree_[vertex_of_current_suffix].right_ + 1;
+        vertex_of_current_suffix = suf_link_[vertex_of_current_suffix];
+        position_on_edge = right_[vertex_of_current_suffix] + 1;
 
         continue;
       }
-      vertex_of_current_suffix =
-          tree_[vertex_of_current_suffix].next_vertices_[letter];
-      position_on_edge = tree_[vertex_of_current_suffix].left_;
+      vertex_of_current_suffix = next_vertex;
+      position_on_edge = left_[vertex_of_current_suffix];
     }
 
     if (position_on_edge == -1 || letter == string_[position_on_edge]) {
@@ -102,161 +434,621 @@ void SuffixTree::InsertLetter(char letter) {
       break;
     }
 
-    tree_[position_of_new_vertex_] =
-        Vertex(tree_[vertex_of_current_suffix].left_, position_on_edge - 1,
-               tree_[vertex_of_current_suffix].parent_);
-    tree_[position_of_new_vertex_].next_vertices_[string_[position_on_edge]] =
-        vertex_of_current_suffix;
-    tree_[position_of_new_vertex_].next_vertices_[letter] =
-        position_of_new_vertex_ + 1;
-    tree_[position_of_new_vertex_ + 1].left_ = position_in_string_;
-    tree_[position_of_new_vertex_ + 1].parent_ = position_of_new_vertex_;
+    InitializeVertex(position_of_new_vertex_, left_[vertex_of_current_suffix],
+                     position_on_edge - 1, parent_[vertex_of_current_suffix]);
+    next_vertices_.Set(position_of_new_vertex_, string_[position_on_edge],
+                       vertex_of_current_suffix);
+    next_vertices_.Set(position_of_new_vertex_, letter,
+                       position_of_new_vertex_ + 1);
+    InitializeVertex(position_of_new_vertex_ + 1, position_in_string_,
+                     static_cast<int>(string_.size()) - 1,
+                     position_of_new_vertex_);
 
-    tree_[vertex_of_current_suffix].left_ = position_on_edge;
-    tree_[vertex_of_current_suffix].parent_ = position_of_new_vertex_;
-    tree_[tree_[position_of_new_vertex_].parent_]
-        .next_vertices_[string_[tree_[position_of_new_vertex_].left_]] =
-        position_of_new_vertex_;
+    left_[vertex_of_current_suffix] = position_on_edge;
+    parent_[vertex_of_current_suffix] = position_of_new_vertex_;
+    next_vertices_.Set(parent_[position_of_new_vertex_],
+                       string_[left_[position_of_new_vertex_]],
+                       position_of_new_vertex_);
 
     position_of_new_vertex_ += 2;
 
-    vertex_of_current_suffix =
-        tree_[tree_[position_of_new_vertex_ - 2].parent_].suf_link_;
-    position_on_edge = tree_[position_of_new_vertex_ - 2].left_;
+    vertex_of_current_suffix = suf_link_[parent_[position_of_new_vertex_ - 2]];
+    position_on_edge = left_[position_of_new_vertex_ - 2];
 
-    while (position_on_edge <= tree_[position_of_new_vertex_ - 2].right_) {
-      vertex_of_current_suffix = tree_[vertex_of_current_suffix]
-                                     .next_vertices_[string_[position_on_edge]];
-      position_on_edge += tree_[vertex_of_current_suffix].right_ -
-                          tree_[vertex_of_current_suffix].left_ + 1;
+    while (position_on_edge <= right_[position_of_new_vertex_ - 2]) {
+      vertex_of_current_suffix =
+          Child(vertex_of_current_suffix, string_[position_on_edge]);
+      position_on_edge += right_[vertex_of_current_suffix] -
+                          left_[vertex_of_current_suffix] + 1;
     }
 
-    if (position_on_edge == tree_[position_of_new_vertex_ - 2].right_ + 1) {
-      tree_[position_of_new_vertex_ - 2].suf_link_ = vertex_of_current_suffix;
+    if (position_on_edge == right_[position_of_new_vertex_ - 2] + 1) {
+      suf_link_[position_of_new_vertex_ - 2] = vertex_of_current_suffix;
     } else {
-      tree_[position_of_new_vertex_ - 2].suf_link_ = position_of_new_vertex_;
+      suf_link_[position_of_new_vertex_ - 2] = position_of_new_vertex_;
     }
 
     position_on_edge =
-        tree_[vertex_of_current_suffix].right_ -
-        (position_on_edge - tree_[position_of_new_vertex_ - 2].right_) + 2;
+        right_[vertex_of_current_suffix] -
+        (position_on_edge - right_[position_of_new_vertex_ - 2]) + 2;
   }
 }
 
-void SuffixTree::MarkSubstringVertices() {
-  visited_.resize(position_of_new_vertex_);
-  vertex_numbers.resize(position_of_new_vertex_);
-  UpdateTerminalInfo(0);
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::CountCommonSubstrings() {
+  terminal_mask_.assign(position_of_new_vertex_, 0);
+  common_substrings_.assign(position_of_new_vertex_, 0);
+
+  // every leaf is a terminal one, the string it belongs to is decided by the
+  // start of its edge, because the edge contains the terminator of the string
+  ForEachPostOrder(next_vertices_, 0, [this](int current_vertex) {
+    if (current_vertex == 0) {
+      return;
+    }
+    if (terminal_mask_[current_vertex] == 0) {
+      terminal_mask_[current_vertex] = left_[current_vertex] < first_part_size_
+                                           ? FIRST_TERMINAL_
+                                           : SECOND_TERMINAL_;
+    }
+    if (terminal_mask_[current_vertex] == BOTH_TERMINALS_) {
+      common_substrings_[current_vertex] +=
+          right_[current_vertex] - left_[current_vertex] + 1;
+    }
+
+    int parent = parent_[current_vertex];
+    terminal_mask_[parent] |= terminal_mask_[current_vertex];
+    common_substrings_[parent] += common_substrings_[current_vertex];
+  });
 }
 
-void SuffixTree::UpdateTerminalInfo(int current_vertex) {
-  visited_[current_vertex] = true;
-  if (current_vertex != 0) {
-    vertex_numbers[current_vertex] = vertex_number;
-    ++vertex_number;
-
-    int string_index = (tree_[current_vertex].left_ < first_part_size_) ? 0 : 1;
-
-    int rg = (!string_index && tree_[current_vertex].right_ >= first_part_size_)
-                 ? first_part_size_
-                 : tree_[current_vertex].right_ + 1 -
-                       first_part_size_ * string_index;
-
-    if (rg == first_part_size_ && string_index == 0) {
-      tree_[current_vertex].has_first_terminal = true;
-      int ind = tree_[current_vertex].parent_;
-      while (ind != 0 && !tree_[ind].has_first_terminal) {
-        tree_[ind].has_first_terminal = true;
-        ind = tree_[ind].parent_;
+template <class ChildStorage>
+typename SuffixTree<ChildStorage>::SubstringPosition
+SuffixTree<ChildStorage>::FindKthStatistic(long long k) const {
+  SubstringPosition result;
+  if (k < 1 || k > common_substrings_[0]) {
+    return result;
+  }
+
+  // every prefix of a path to a vertex with both terminals below is a common
+  // substring, so the answer either ends on the edge of the first such child
+  // or lies in its subtree
+  int current_vertex = 0;
+  int depth = 0;
+  while (result.length == 0) {
+    int next_vertex = -1;
+    next_vertices_.ForEach(current_vertex, [&](char, int child) {
+      if (next_vertex != -1 || result.length != 0 ||
+          terminal_mask_[child] != BOTH_TERMINALS_) {
+        return;
       }
-    }
-    if (rg == string_.size() - first_part_size_ && string_index == 1) {
-      tree_[current_vertex].has_second_terminal = true;
-      int ind = tree_[current_vertex].parent_;
-      while (ind != 0 && !tree_[ind].has_second_terminal) {
-        tree_[ind].has_second_terminal = true;
-        ind = tree_[ind].parent_;
+      long long edge_length = right_[child] - left_[child] + 1;
+      if (k <= edge_length) {
+        result.offset = left_[child] - depth;
+        result.length = depth + static_cast<int>(k);
+      } else if (k <= common_substrings_[child]) {
+        k -= edge_length;
+        depth += static_cast<int>(edge_length);
+        next_vertex = child;
+      } else {
+        k -= common_substrings_[child];
       }
+    });
+    if (result.length == 0 && next_vertex == -1) {
+      // the counts do not add up to k, no answer rather than a walk off the
+      // tree
+      return result;
     }
+    current_vertex = next_vertex;
+  }
+
+  return result;
+}
+
+template <class ChildStorage>
+void SuffixTree<ChildStorage>::AnswerQueries(const long long* begin,
+                                             const long long* end,
+                                             SubstringPosition* result) const {
+  // common substrings are counted in lexicographic order, passed is the
+  // number of them before the current edge, depth is the length of the path
+  // to the top of the current edge
+  long long passed = 0;
+  int depth = 0;
+  // there is no k-th substring for k < 1, those answers stay empty
+  while (begin != end && *begin < 1) {
+    ++begin;
+    ++result;
+  }
+  TraverseDepthFirst(
+      next_vertices_, 0,
+      [&](int current_vertex) {
+        if (current_vertex == 0) {
+          return true;
+        }
+        if (begin == end ||
+            terminal_mask_[current_vertex] != BOTH_TERMINALS_) {
+          return false;
+        }
+
+        int edge_length = right_[current_vertex] - left_[current_vertex] + 1;
+        while (begin != end && *begin <= passed + edge_length) {
+          result->offset = left_[current_vertex] - depth;
+          result->length = depth + static_cast<int>(*begin - passed);
+          ++begin;
+          ++result;
+        }
+        passed += edge_length;
+
+        long long below = common_substrings_[current_vertex] - edge_length;
+        if (begin == end || *begin > passed + below) {
+          passed += below;
+          return false;
+        }
+        depth += edge_length;
+        return true;
+      },
+      [&](int current_vertex) {
+        if (current_vertex != 0) {
+          depth -= right_[current_vertex] - left_[current_vertex] + 1;
+        }
+      });
+}
+
+template <class ChildStorage>
+std::vector<typename SuffixTree<ChildStorage>::SubstringPosition>
+SuffixTree<ChildStorage>::FindKthStatistics(
+    const std::vector<long long>& sorted_k) const {
+  std::vector<SubstringPosition> result(sorted_k.size());
+  AnswerQueries(sorted_k.data(), sorted_k.data() + sorted_k.size(),
+                result.data());
+  return result;
+}
+
+template <class ChildStorage>
+std::vector<typename SuffixTree<ChildStorage>::SubstringPosition>
+SuffixTree<ChildStorage>::FindKthStatistics(
+    const std::vector<long long>& sorted_k, int number_of_threads) const {
+  std::vector<SubstringPosition> result(sorted_k.size());
+  size_t parts = std::max(number_of_threads, 1);
+  size_t part_size = (sorted_k.size() + parts - 1) / parts;
+
+  std::vector<std::thread> threads;
+  for (size_t begin = 0; begin < sorted_k.size(); begin += part_size) {
+    size_t end = std::min(sorted_k.size(), begin + part_size);
+    threads.emplace_back([this, &sorted_k, &result, begin, end]() {
+      AnswerQueries(sorted_k.data() + begin, sorted_k.data() + end,
+                    result.data() + begin);
+    });
   }
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+  return result;
+}
+
+template <class ChildStorage>
+typename SuffixTree<ChildStorage>::SubstringPosition
+SuffixTree<ChildStorage>::LongestCommonSubstring() const {
+  // the answer is the deepest vertex with both terminals below, such
+  // vertices form a subtree containing the root
+  SubstringPosition result;
+  int depth = 0;
+  TraverseDepthFirst(
+      next_vertices_, 0,
+      [&](int current_vertex) {
+        if (current_vertex == 0) {
+          return true;
+        }
+        if (terminal_mask_[current_vertex] != BOTH_TERMINALS_) {
+          return false;
+        }
+        depth += EdgeLength(current_vertex);
+        if (depth > result.length) {
+          result.offset = right_[current_vertex] + 1 - depth;
+          result.length = depth;
+        }
+        return true;
+      },
+      [&](int current_vertex) {
+        if (current_vertex != 0) {
+          depth -= EdgeLength(current_vertex);
+        }
+      });
+  return result;
+}
+
+template <class ChildStorage>
+std::vector<int> SuffixTree<ChildStorage>::MatchingStatistics(
+    const std::string& query) const {
+  std::vector<int> result(query.size());
+
+  // the matched prefix ends on_edge letters below current_vertex on the edge
+  // to child, or exactly at current_vertex if on_edge is 0
+  int current_vertex = 0;
+  int child = -1;
+  int on_edge = 0;
+  int length = 0;
+  for (size_t i = 0; i < query.size(); ++i) {
+    while (i + length < query.size()) {
+      char letter = query[i + length];
+      if (on_edge == 0) {
+        child = next_vertices_.Find(current_vertex, letter);
+        if (child == -1) {
+          break;
+        }
+      }
+      if (string_[left_[child] + on_edge] != letter) {
+        break;
+      }
+      ++on_edge;
+      ++length;
+      if (on_edge == EdgeLength(child)) {
+        current_vertex = child;
+        on_edge = 0;
+      }
+    }
+    result[i] = length;
 
-  for (auto&& pair : tree_[current_vertex].next_vertices_) {
-    if (!visited_[pair.second]) {
-      UpdateTerminalInfo(pair.second);
+    if (length == 0) {
+      continue;
+    }
+    --length;
+
+    // drop the first letter: jump by the suffix link of the vertex above and
+    // rescan the part of the edge that was matched, skipping whole edges
+    if (on_edge == 0) {
+      current_vertex = suf_link_[current_vertex];
+      continue;
+    }
+    int from = left_[child];
+    int count = on_edge;
+    if (current_vertex == 0) {
+      ++from;
+      --count;
+    } else {
+      current_vertex = suf_link_[current_vertex];
+    }
+    on_edge = 0;
+    while (count > 0) {
+      child = next_vertices_.Find(current_vertex, string_[from]);
+      if (EdgeLength(child) > count) {
+        on_edge = count;
+        break;
+      }
+      current_vertex = child;
+      from += EdgeLength(child);
+      count -= EdgeLength(child);
     }
   }
+
+  return result;
 }
 
-std::string SuffixTree::FindKthStatistic(long long k) {
-  MarkSubstringVertices();
+// Suffix tree of many documents at once. The documents are concatenated with
+// a distinct terminator after each of them (symbols are ints, terminator of
+// document d is -d - 1), so no internal edge contains a terminator and every
+// leaf belongs to exactly one document. For every vertex we keep the number
+// of distinct documents in its subtree.
+class GeneralizedSuffixTree {
+ public:
+  explicit GeneralizedSuffixTree(const std::vector<std::string>& documents);
+
+  int NumberOfDocuments() const { return document_begin_.size() - 1; }
+  // number of documents that contain pattern
+  int CountDocuments(const std::string& pattern) const;
+  // sorted ids of documents that contain pattern
+  std::vector<int> FindDocuments(const std::string& pattern) const;
+  // longest string that occurs in at least number_of_documents documents
+  std::string LongestCommonSubstring(int number_of_documents) const;
+
+ private:
+  int Child(int vertex, int symbol) const {
+    // the auxiliary vertex 1 leads to the root by any symbol
+    return vertex == 1 ? 0 : next_vertices_.Find(vertex, symbol);
+  }
+  int DocumentOf(int position) const;
+  // vertex below the end of pattern, -1 if pattern does not occur
+  int Descend(const std::string& pattern) const;
+
+  void InitializeVertex(int vertex, int left, int right, int parent);
+  void InsertSymbol(int symbol);
+  void CountDocumentsInSubtrees();
 
-  visited_.assign(position_of_new_vertex_, false);
-  vertex_numbers.assign(position_of_new_vertex_, 0);
-  k_ = k;
-  counter_ = 0;
-  kth_statistic_.clear();
+  std::vector<int> text_;
+  std::vector<int> document_begin_;
 
-  FillResultString(0);
+  std::unique_ptr<int[]> arena_;
+  int* left_ = nullptr;
+  int* right_ = nullptr;
+  int* parent_ = nullptr;
+  int* suf_link_ = nullptr;
+  HashTableChildren<IntegerAlphabet> next_vertices_;
+  int position_of_new_vertex_ = 2;
+  int position_in_string_ = 0;
+  int vertex_of_current_suffix = 0;
+  int position_on_edge = 0;
 
-  std::reverse(kth_statistic_.begin(), kth_statistic_.end());
+  // children of vertex v are children_[child_begin_[v] .. child_begin_[v + 1])
+  std::vector<int> child_begin_;
+  std::vector<int> children_;
+  std::vector<int> depth_;
+  std::vector<int> document_count_;
+  // leaves in DFS order, the subtree of v is leaf_order_[leaf_begin_[v] ..
+  // leaf_end_[v])
+  std::vector<int> leaf_order_;
+  std::vector<int> leaf_begin_;
+  std::vector<int> leaf_end_;
+};
 
-  if (kth_statistic_.empty()) {
-    return "-1";
+GeneralizedSuffixTree::GeneralizedSuffixTree(
+    const std::vector<std::string>& documents) {
+  for (size_t i = 0; i < documents.size(); ++i) {
+    document_begin_.push_back(text_.size());
+    for (auto&& symbol : documents[i]) {
+      text_.push_back(static_cast<unsigned char>(symbol));
+    }
+    text_.push_back(-static_cast<int>(i) - 1);
   }
+  document_begin_.push_back(text_.size());
 
-  return kth_statistic_;
+  size_t capacity = 2 * text_.size() + 2;
+  arena_.reset(new int[4 * capacity]);
+  left_ = arena_.get();
+  right_ = left_ + capacity;
+  parent_ = right_ + capacity;
+  suf_link_ = parent_ + capacity;
+  next_vertices_.Reserve(capacity);
+
+  InitializeVertex(0, -1, -1, -1);
+  InitializeVertex(1, -1, -1, -1);
+  suf_link_[0] = 1;
+
+  for (auto&& symbol : text_) {
+    InsertSymbol(symbol);
+    ++position_in_string_;
+  }
+
+  CountDocumentsInSubtrees();
 }
 
-void SuffixTree::FillResultString(int current_vertex) {
-  visited_[current_vertex] = true;
-  if (current_vertex != 0 && tree_[current_vertex].has_first_terminal &&
-      tree_[current_vertex].has_second_terminal && counter_ < k_) {
-    int lf = tree_[current_vertex].left_;
-    int rg = tree_[current_vertex].right_;
-    if (counter_ + rg - lf + 1 < k_) {
-      counter_ += rg - lf + 1;
-    } else {
-      lf = tree_[current_vertex].left_;
-      rg = lf + k_ - counter_ - 1;
+void GeneralizedSuffixTree::InitializeVertex(int vertex, int left, int right,
+                                             int parent) {
+  left_[vertex] = left;
+  right_[vertex] = right;
+  parent_[vertex] = parent;
+  suf_link_[vertex] = 0;
+}
 
-      std::stack<char> buffer;
+void GeneralizedSuffixTree::InsertSymbol(int symbol) {
+  int last = static_cast<int>(text_.size()) - 1;
+  while (true) {
+    if (right_[vertex_of_current_suffix] < position_on_edge) {
+      int next_vertex = Child(vertex_of_current_suffix, symbol);
+      if (next_vertex == -1) {
+        next_vertices_.Set(vertex_of_current_suffix, symbol,
+                           position_of_new_vertex_);
+        InitializeVertex(position_of_new_vertex_, position_in_string_, last,
+                         vertex_of_current_suffix);
+        ++position_of_new_vertex_;
 
-      for (int i = lf; i <= rg; ++i) {
-        buffer.push(string_[i]);
-      }
+        vertex_of_current_suffix = suf_link_[vertex_of_current_suffix];
+        position_on_edge = right_[vertex_of_current_suffix] + 1;
 
-      while (!buffer.empty()) {
-        kth_statistic_.push_back(buffer.top());
-        buffer.pop();
+        continue;
       }
+      vertex_of_current_suffix = next_vertex;
+      position_on_edge = left_[vertex_of_current_suffix];
+    }
 
-      int ind = tree_[current_vertex].parent_;
-      while (ind != -1 && tree_[ind].has_second_terminal &&
-             tree_[ind].has_first_terminal) {
-        lf = tree_[ind].left_;
-        rg = tree_[ind].right_;
+    if (position_on_edge == -1 || symbol == text_[position_on_edge]) {
+      ++position_on_edge;
+      break;
+    }
 
-        for (int i = lf; i <= rg; ++i) {
-          buffer.push(string_[i]);
-        }
+    int split = position_of_new_vertex_;
+    InitializeVertex(split, left_[vertex_of_current_suffix],
+                     position_on_edge - 1, parent_[vertex_of_current_suffix]);
+    next_vertices_.Set(split, text_[position_on_edge],
+                       vertex_of_current_suffix);
+    next_vertices_.Set(split, symbol, split + 1);
+    InitializeVertex(split + 1, position_in_string_, last, split);
 
-        while (!buffer.empty()) {
-          kth_statistic_.push_back(buffer.top());
-          buffer.pop();
-        }
+    left_[vertex_of_current_suffix] = position_on_edge;
+    parent_[vertex_of_current_suffix] = split;
+    next_vertices_.Set(parent_[split], text_[left_[split]], split);
+
+    position_of_new_vertex_ += 2;
+
+    vertex_of_current_suffix = suf_link_[parent_[split]];
+    position_on_edge = left_[split];
+
+    while (position_on_edge <= right_[split]) {
+      vertex_of_current_suffix =
+          Child(vertex_of_current_suffix, text_[position_on_edge]);
+      position_on_edge += right_[vertex_of_current_suffix] -
+                          left_[vertex_of_current_suffix] + 1;
+    }
+
+    if (position_on_edge == right_[split] + 1) {
+      suf_link_[split] = vertex_of_current_suffix;
+    } else {
+      suf_link_[split] = position_of_new_vertex_;
+    }
+
+    position_on_edge = right_[vertex_of_current_suffix] -
+                       (position_on_edge - right_[split]) + 2;
+  }
+}
+
+int GeneralizedSuffixTree::DocumentOf(int position) const {
+  return static_cast<int>(std::upper_bound(document_begin_.begin(),
+                                           document_begin_.end(), position) -
+                          document_begin_.begin()) -
+         1;
+}
+
+void GeneralizedSuffixTree::CountDocumentsInSubtrees() {
+  int number_of_vertices = position_of_new_vertex_;
+
+  child_begin_.assign(number_of_vertices + 1, 0);
+  for (int vertex = 2; vertex < number_of_vertices; ++vertex) {
+    ++child_begin_[parent_[vertex] + 1];
+  }
+  for (int vertex = 0; vertex < number_of_vertices; ++vertex) {
+    child_begin_[vertex + 1] += child_begin_[vertex];
+  }
+  children_.resize(child_begin_.back());
+  std::vector<int> filled(child_begin_.begin(), child_begin_.end() - 1);
+  for (int vertex = 2; vertex < number_of_vertices; ++vertex) {
+    children_[filled[parent_[vertex]]++] = vertex;
+  }
+
+  // Hui's trick: every leaf adds one to its document, and the LCA of two
+  // consecutive (in DFS order) leaves of the same document subtracts it back.
+  // LCAs are found offline by Tarjan's algorithm on a disjoint set union
+  // with path compression and union by size, O(n alpha(n)) in total. The root
+  // of a set is not the vertex it stands for, that one is kept in ancestor.
+  std::vector<int> dsu_parent(number_of_vertices);
+  std::vector<int> dsu_size(number_of_vertices);
+  std::vector<int> ancestor(number_of_vertices);
+  std::vector<int> last_leaf(NumberOfDocuments(), -1);
+  auto find = [&dsu_parent](int vertex) {
+    int root = vertex;
+    while (dsu_parent[root] != root) {
+      root = dsu_parent[root];
+    }
+    while (dsu_parent[vertex] != root) {
+      int next = dsu_parent[vertex];
+      dsu_parent[vertex] = root;
+      vertex = next;
+    }
+    return root;
+  };
+  // merges the finished subtree of vertex into the set of its parent
+  auto unite = [&](int vertex, int parent) {
+    int child_root = find(vertex);
+    int parent_root = find(parent);
+    if (dsu_size[child_root] > dsu_size[parent_root]) {
+      std::swap(child_root, parent_root);
+    }
+    dsu_parent[child_root] = parent_root;
+    dsu_size[parent_root] += dsu_size[child_root];
+    ancestor[parent_root] = parent;
+  };
+
+  depth_.assign(number_of_vertices, 0);
+  document_count_.assign(number_of_vertices, 0);
+  leaf_begin_.assign(number_of_vertices, 0);
+  leaf_end_.assign(number_of_vertices, 0);
+  leaf_order_.clear();
 
-        ind = tree_[ind].parent_;
+  std::vector<std::pair<int, bool>> stack = {{0, false}};
+  while (!stack.empty()) {
+    int vertex = stack.back().first;
+    bool is_exit = stack.back().second;
+    stack.pop_back();
+
+    if (is_exit) {
+      leaf_end_[vertex] = leaf_order_.size();
+      if (vertex != 0) {
+        int parent = parent_[vertex];
+        document_count_[parent] += document_count_[vertex];
+        unite(vertex, parent);
       }
+      continue;
+    }
+
+    dsu_parent[vertex] = vertex;
+    dsu_size[vertex] = 1;
+    ancestor[vertex] = vertex;
+    leaf_begin_[vertex] = leaf_order_.size();
+    if (vertex != 0) {
+      depth_[vertex] = depth_[parent_[vertex]] + right_[vertex] -
+                       left_[vertex] + 1;
+    }
+
+    if (child_begin_[vertex] == child_begin_[vertex + 1]) {
+      // a leaf, its suffix starts depth(parent) symbols before its edge
+      int document = DocumentOf(left_[vertex] - depth_[parent_[vertex]]);
+      leaf_order_.push_back(vertex);
+      ++document_count_[vertex];
+      if (last_leaf[document] != -1) {
+        --document_count_[ancestor[find(last_leaf[document])]];
+      }
+      last_leaf[document] = vertex;
+    }
+
+    stack.emplace_back(vertex, true);
+    for (int i = child_begin_[vertex + 1] - 1; i >= child_begin_[vertex]; --i) {
+      stack.emplace_back(children_[i], false);
+    }
+  }
+}
 
-      counter_ = k_;
+int GeneralizedSuffixTree::Descend(const std::string& pattern) const {
+  int vertex = 0;
+  size_t matched = 0;
+  while (matched < pattern.size()) {
+    vertex = next_vertices_.Find(
+        vertex, static_cast<unsigned char>(pattern[matched]));
+    if (vertex == -1) {
+      return -1;
+    }
+    for (int i = left_[vertex]; i <= right_[vertex] && matched < pattern.size();
+         ++i, ++matched) {
+      if (text_[i] != static_cast<unsigned char>(pattern[matched])) {
+        return -1;
+      }
     }
   }
+  return vertex;
+}
+
+int GeneralizedSuffixTree::CountDocuments(const std::string& pattern) const {
+  int vertex = Descend(pattern);
+  return vertex == -1 ? 0 : document_count_[vertex];
+}
 
-  for (auto&& pair : tree_[current_vertex].next_vertices_) {
-    if (!visited_[pair.second]) {
-      FillResultString(pair.second);
+std::vector<int> GeneralizedSuffixTree::FindDocuments(
+    const std::string& pattern) const {
+  std::vector<int> result;
+  int vertex = Descend(pattern);
+  if (vertex == -1) {
+    return result;
+  }
+  for (int i = leaf_begin_[vertex]; i < leaf_end_[vertex]; ++i) {
+    int leaf = leaf_order_[i];
+    result.push_back(DocumentOf(left_[leaf] - depth_[parent_[leaf]]));
+  }
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+std::string GeneralizedSuffixTree::LongestCommonSubstring(
+    int number_of_documents) const {
+  int best_begin = 0;
+  int best_length = 0;
+  for (int vertex = 2; vertex < position_of_new_vertex_; ++vertex) {
+    if (document_count_[vertex] < number_of_documents) {
+      continue;
+    }
+    int begin = right_[vertex] + 1 - depth_[vertex];
+    int length = depth_[vertex];
+    if (child_begin_[vertex] == child_begin_[vertex + 1]) {
+      // a leaf edge runs past the terminator of its document
+      length = document_begin_[DocumentOf(begin) + 1] - 1 - begin;
     }
+    if (length > best_length) {
+      best_begin = begin;
+      best_length = length;
+    }
+  }
+
+  std::string result;
+  for (int i = best_begin; i < best_begin + best_length; ++i) {
+    result.push_back(static_cast<char>(text_[i]));
   }
+  return result;
 }
 
 int main() {
@@ -267,15 +1059,19 @@ int main() {
 
   std::string input_string = first_string + '$' + second_string + '#';
 
-  SuffixTree tree(input_string, first_string.size() + 1);
+  SuffixTree<SortedArrayChildren<TaskAlphabet>> tree(input_string,
+                                                     first_string.size() + 1);
 
   long long k = 0;
   std::cin >> k;
 
-  std::string kth_statistic_ = tree.FindKthStatistic(k);
+  auto kth_statistic = tree.FindKthStatistic(k);
 
-  for (auto&& symbol : kth_statistic_) {
-    printf("%c", symbol);
+  if (kth_statistic.length == 0) {
+    printf("-1");
+  } else {
+    printf("%.*s", kth_statistic.length,
+           input_string.c_str() + kth_statistic.offset);
   }
 
   return 0;
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+// the classes of the solution, its main is renamed out of the way
+#define main SolveFromInput
+#include "main.cpp"
+#undef main
+
+// Random pairs of segments in [-10, 10]^3, a sixth of them degenerate, a
+// sixth parallel and a sixth collinear with overlap, as the batch kernel has
+// a branch for each. The pairs are made in double and converted to Scalar.
+// FindDistances (the widest kernel the build enables, if there is one for
+// Scalar) and FindDistancesScalar are timed on the same pairs and compared
+// with the long double scalar path.
+//
+// g++ -std=c++17 -O2 [-mavx2 -mfma | -mavx512f] bench.cpp -o bench &&
+//     ./bench [number_of_pairs]
+template <class Scalar>
+class SegmentDistanceBenchmark {
+ public:
+  SegmentDistanceBenchmark(const char* name, size_t number_of_pairs)
+      : name_(name), number_of_pairs_(number_of_pairs) {}
+
+  void operator()() {
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> coordinate(-10, 10);
+    auto random_point = [&]() {
+      return Point(coordinate(generator), coordinate(generator),
+                   coordinate(generator));
+    };
+
+    SegmentArrays pairs_first;
+    SegmentArrays pairs_second;
+    for (size_t i = 0; i < number_of_pairs_; ++i) {
+      Point a = random_point();
+      Point b = random_point();
+      Point c = random_point();
+      Point d = random_point();
+      switch (generator() % 6) {
+        case 0:
+          b = a;
+          break;
+        case 1:
+          d = c + (b - a);
+          break;
+        case 2:
+          c = a + 0.5 * (b - a);
+          d = a + 2 * (b - a);
+          break;
+      }
+      pairs_first.Add(Segment(a, b));
+      pairs_second.Add(Segment(c, d));
+    }
+
+    std::vector<long double> exact(number_of_pairs_);
+    FindDistancesScalar(Convert<long double>(pairs_first),
+                        Convert<long double>(pairs_second), 0,
+                        number_of_pairs_, exact.data());
+
+    BasicSegmentArrays<Scalar> first = Convert<Scalar>(pairs_first);
+    BasicSegmentArrays<Scalar> second = Convert<Scalar>(pairs_second);
+    std::vector<Scalar> distances(number_of_pairs_);
+    double batch_time = BestTime([&]() {
+      FindDistances(first, second, distances.data());
+    });
+    double batch_error = MaxRelativeError(distances, exact);
+    double scalar_time = BestTime([&]() {
+      FindDistancesScalar(first, second, 0, number_of_pairs_,
+                          distances.data());
+    });
+    double scalar_error = MaxRelativeError(distances, exact);
+
+    printf("%-12s batch %6.1f Mpairs/s, scalar %5.1f Mpairs/s, max error: "
+           "batch %.2g, scalar %.2g\n",
+           name_, number_of_pairs_ / batch_time / 1e6,
+           number_of_pairs_ / scalar_time / 1e6, batch_error, scalar_error);
+  }
+
+ private:
+  constexpr static const int REPETITIONS_ = 5;
+
+  template <class To>
+  static BasicSegmentArrays<To> Convert(const SegmentArrays& arrays) {
+    BasicSegmentArrays<To> result;
+    for (size_t i = 0; i < arrays.Size(); ++i) {
+      Segment segment = arrays.Get(i);
+      result.Add(BasicSegment<To>(
+          BasicPoint<To>(segment.first_point_.x_, segment.first_point_.y_,
+                         segment.first_point_.z_),
+          BasicPoint<To>(segment.second_point_.x_, segment.second_point_.y_,
+                         segment.second_point_.z_)));
+    }
+    return result;
+  }
+
+  // relative to the distance, or absolute for distances below 1
+  static double MaxRelativeError(const std::vector<Scalar>& distances,
+                                 const std::vector<long double>& exact) {
+    long double result = 0;
+    for (size_t i = 0; i < distances.size(); ++i) {
+      long double error = std::abs(distances[i] - exact[i]);
+      result = std::max(result, error / std::max<long double>(1, exact[i]));
+    }
+    return static_cast<double>(result);
+  }
+
+  // the fastest of REPETITIONS_ runs, in seconds
+  template <class Function>
+  static double BestTime(Function function) {
+    double result = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < REPETITIONS_; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      function();
+      result = std::min(result, std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count());
+    }
+    return result;
+  }
+
+  const char* name_;
+  size_t number_of_pairs_;
+};
+
+int main(int argc, char** argv) {
+  size_t number_of_pairs = argc > 1 ? atol(argv[1]) : 200000;
+
+  SegmentDistanceBenchmark<float> float_benchmark("float", number_of_pairs);
+  float_benchmark();
+  SegmentDistanceBenchmark<double> double_benchmark("double",
+                                                    number_of_pairs);
+  double_benchmark();
+  SegmentDistanceBenchmark<long double> long_double_benchmark(
+      "long double", number_of_pairs);
+  long_double_benchmark();
+
+  return 0;
+}
@@ -1,73 +1,107 @@
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstddef>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-struct Segment;
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
-struct Vector {
-  explicit Vector(double x = 0, double y = 0, double z = 0)
+// The geometry is written for any scalar type: double is the default, float
+// halves the memory and doubles the width of the vector kernels, long double
+// gives more precise answers.
+
+template <class Scalar>
+struct BasicSegment;
+
+template <class Scalar>
+struct BasicVector {
+  using Coordinate = Scalar;
+
+  constexpr explicit BasicVector(Scalar x = 0, Scalar y = 0, Scalar z = 0)
       : x_(x), y_(y), z_(z) {}
 
-  explicit Vector(const Segment& segment);
+  constexpr explicit BasicVector(const BasicSegment<Scalar>& segment);
 
-  double Module() { return pow((x_ * x_ + y_ * y_ + z_ * z_), 0.5); }
+  Scalar Module() const { return std::sqrt(x_ * x_ + y_ * y_ + z_ * z_); }
 
-  double x_;
-  double y_;
-  double z_;
+  Scalar x_;
+  Scalar y_;
+  Scalar z_;
 };
 
-using Point = Vector;
+template <class Scalar>
+using BasicPoint = BasicVector<Scalar>;
 
-struct Segment {
-  explicit Segment(const Point& first_point, const Point& second_point)
+template <class Scalar>
+struct BasicSegment {
+  constexpr explicit BasicSegment(const BasicPoint<Scalar>& first_point,
+                                  const BasicPoint<Scalar>& second_point)
       : first_point_(first_point), second_point_(second_point) {}
 
-  Point first_point_;
-  Point second_point_;
+  BasicPoint<Scalar> first_point_;
+  BasicPoint<Scalar> second_point_;
 };
 
-Vector::Vector(const Segment& segment) {
-  x_ = segment.first_point_.x_ - segment.second_point_.x_;
-  y_ = segment.first_point_.y_ - segment.second_point_.y_;
-  z_ = segment.first_point_.z_ - segment.second_point_.z_;
-}
+using Vector = BasicVector<double>;
+using Point = Vector;
+using Segment = BasicSegment<double>;
 
-Vector operator-(const Vector& first_vector, const Vector& second_vector) {
-  Vector result;
-  result.x_ = first_vector.x_ - second_vector.x_;
-  result.y_ = first_vector.y_ - second_vector.y_;
-  result.z_ = first_vector.z_ - second_vector.z_;
-  return result;
+template <class Scalar>
+constexpr BasicVector<Scalar>::BasicVector(const BasicSegment<Scalar>& segment)
+    : x_(segment.first_point_.x_ - segment.second_point_.x_),
+      y_(segment.first_point_.y_ - segment.second_point_.y_),
+      z_(segment.first_point_.z_ - segment.second_point_.z_) {}
+
+template <class Scalar>
+constexpr BasicVector<Scalar> operator-(
+    const BasicVector<Scalar>& first_vector,
+    const BasicVector<Scalar>& second_vector) {
+  return BasicVector<Scalar>(first_vector.x_ - second_vector.x_,
+                             first_vector.y_ - second_vector.y_,
+                             first_vector.z_ - second_vector.z_);
 }
 
-Vector operator+(const Vector& first_vector, const Vector& second_vector) {
-  Vector result;
-  result.x_ = first_vector.x_ + second_vector.x_;
-  result.y_ = first_vector.y_ + second_vector.y_;
-  result.z_ = first_vector.z_ + second_vector.z_;
-  return result;
+template <class Scalar>
+constexpr BasicVector<Scalar> operator+(
+    const BasicVector<Scalar>& first_vector,
+    const BasicVector<Scalar>& second_vector) {
+  return BasicVector<Scalar>(first_vector.x_ + second_vector.x_,
+                             first_vector.y_ + second_vector.y_,
+                             first_vector.z_ + second_vector.z_);
 }
 
-Vector operator*(double constant, const Vector& vector) {
-  Vector result;
-  result.x_ = constant * vector.x_;
-  result.y_ = constant * vector.y_;
-  result.z_ = constant * vector.z_;
-  return result;
+// the type of the constant is taken from the vector, so (-1) * vector works
+template <class Scalar>
+constexpr BasicVector<Scalar> operator*(
+    typename BasicVector<Scalar>::Coordinate constant,
+    const BasicVector<Scalar>& vector) {
+  return BasicVector<Scalar>(constant * vector.x_, constant * vector.y_,
+                             constant * vector.z_);
 }
 
-double ScalarProduct(const Vector& first_vector, const Vector& second_vector) {
+template <class Scalar>
+constexpr Scalar ScalarProduct(const BasicVector<Scalar>& first_vector,
+                               const BasicVector<Scalar>& second_vector) {
   return first_vector.x_ * second_vector.x_ +
          first_vector.y_ * second_vector.y_ +
          first_vector.z_ * second_vector.z_;
 }
 
-double FindDistance(const Point& point, const Segment& segment) {
-  Vector vector = (-1) * Vector(segment);
-  auto p0 = Vector(point);
-  auto b = Vector(segment.first_point_);
-  double parameter = (ScalarProduct(p0, vector) - ScalarProduct(b, vector)) /
+template <class Scalar>
+Scalar FindDistance(const BasicPoint<Scalar>& point,
+                    const BasicSegment<Scalar>& segment) {
+  BasicVector<Scalar> vector = (-1) * BasicVector<Scalar>(segment);
+  auto p0 = point;
+  auto b = segment.first_point_;
+  Scalar parameter = (ScalarProduct(p0, vector) - ScalarProduct(b, vector)) /
                      (ScalarProduct(vector, vector));
   if (parameter <= 1 && parameter >= 0) {
     return (b + parameter * vector - p0).Module();
@@ -78,42 +112,765 @@ double FindDistance(const Point& point, const Segment& segment) {
   return (b + vector - p0).Module();
 }
 
-double FindDistance(const Segment& first_segment,
-                    const Segment& second_segment) {
-  Vector u(first_segment);
-  Vector v(second_segment);
+template <class Scalar>
+Scalar FindDistance(const BasicSegment<Scalar>& first_segment,
+                    const BasicSegment<Scalar>& second_segment) {
+  BasicVector<Scalar> u(first_segment);
+  BasicVector<Scalar> v(second_segment);
   u = (-1) * u;
   v = (-1) * v;
 
-  Point w0 = first_segment.first_point_ - second_segment.first_point_;
+  BasicPoint<Scalar> w0 =
+      first_segment.first_point_ - second_segment.first_point_;
+
+  Scalar a = ScalarProduct(u, u);
+  Scalar b = ScalarProduct(u, v);
+  Scalar c = ScalarProduct(v, v);
+  Scalar d = ScalarProduct(u, w0);
+  Scalar e = ScalarProduct(v, w0);
 
-  double a = ScalarProduct(u, u);
-  double b = ScalarProduct(u, v);
-  double c = ScalarProduct(v, v);
-  double d = ScalarProduct(u, Vector(w0));
-  double e = ScalarProduct(v, Vector(w0));
+  Scalar j1 = FindDistance(first_segment.first_point_, second_segment);
+  Scalar j2 = FindDistance(first_segment.second_point_, second_segment);
+  Scalar j3 = FindDistance(second_segment.first_point_, first_segment);
+  Scalar j4 = FindDistance(second_segment.second_point_, first_segment);
+  Scalar dist = std::min(std::min(j1, j2), std::min(j3, j4));
 
+  // for almost parallel segments a * c - b * b is a rounding error and the
+  // closest points of the lines are noise, so they are compared with the ends
+  // instead of being trusted
   if (a * c != b * b) {
-    double s_closest = (b * e - c * d) / (a * c - b * b);
-    double t_closest = (a * e - b * d) / (a * c - b * b);
+    Scalar s_closest = (b * e - c * d) / (a * c - b * b);
+    Scalar t_closest = (a * e - b * d) / (a * c - b * b);
     if (s_closest <= 1 && s_closest >= 0 && t_closest >= 0 && t_closest <= 1) {
-      double x = w0.x_ + s_closest * u.x_ - t_closest * v.x_;
-      double y = w0.y_ + s_closest * u.y_ - t_closest * v.y_;
-      double z = w0.z_ + s_closest * u.z_ - t_closest * v.z_;
+      Scalar x = w0.x_ + s_closest * u.x_ - t_closest * v.x_;
+      Scalar y = w0.y_ + s_closest * u.y_ - t_closest * v.y_;
+      Scalar z = w0.z_ + s_closest * u.z_ - t_closest * v.z_;
 
-      Vector distance(x, y, z);
+      BasicVector<Scalar> distance(x, y, z);
 
-      return distance.Module();
+      dist = std::min(dist, distance.Module());
     }
   }
-  double j1 = FindDistance(first_segment.first_point_, second_segment);
-  double j2 = FindDistance(first_segment.second_point_, second_segment);
-  double j3 = FindDistance(second_segment.first_point_, first_segment);
-  double j4 = FindDistance(second_segment.second_point_, first_segment);
-  double dist = std::min(std::min(j1, j2), std::min(j3, j4));
   return dist;
 }
 
+// Many segments stored as structure of arrays, the i-th segment goes from
+// (first_x_[i], first_y_[i], first_z_[i]) to (second_x_[i], second_y_[i],
+// second_z_[i]). The batch kernels load each coordinate of several segments
+// with one instruction.
+template <class Scalar>
+struct BasicSegmentArrays {
+  size_t Size() const { return first_x_.size(); }
+  void Add(const BasicSegment<Scalar>& segment);
+  BasicSegment<Scalar> Get(size_t index) const;
+
+  std::vector<Scalar> first_x_;
+  std::vector<Scalar> first_y_;
+  std::vector<Scalar> first_z_;
+  std::vector<Scalar> second_x_;
+  std::vector<Scalar> second_y_;
+  std::vector<Scalar> second_z_;
+};
+
+using SegmentArrays = BasicSegmentArrays<double>;
+
+template <class Scalar>
+void BasicSegmentArrays<Scalar>::Add(const BasicSegment<Scalar>& segment) {
+  first_x_.push_back(segment.first_point_.x_);
+  first_y_.push_back(segment.first_point_.y_);
+  first_z_.push_back(segment.first_point_.z_);
+  second_x_.push_back(segment.second_point_.x_);
+  second_y_.push_back(segment.second_point_.y_);
+  second_z_.push_back(segment.second_point_.z_);
+}
+
+template <class Scalar>
+BasicSegment<Scalar> BasicSegmentArrays<Scalar>::Get(size_t index) const {
+  return BasicSegment<Scalar>(
+      BasicPoint<Scalar>(first_x_[index], first_y_[index], first_z_[index]),
+      BasicPoint<Scalar>(second_x_[index], second_y_[index],
+                         second_z_[index]));
+}
+
+// distances[i] is the distance between the i-th segments of first and second,
+// one pair at a time with FindDistance
+template <class Scalar>
+void FindDistancesScalar(const BasicSegmentArrays<Scalar>& first,
+                         const BasicSegmentArrays<Scalar>& second,
+                         size_t begin, size_t end, Scalar* distances) {
+  for (size_t i = begin; i < end; ++i) {
+    distances[i] = FindDistance(first.Get(i), second.Get(i));
+  }
+}
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+
+// Lanes wrap the intrinsics of one instruction set for one scalar type, so
+// the kernel below is written once for all of them. Comparisons give masks,
+// and the branches of FindDistance become selects by these masks.
+template <class Scalar>
+struct Avx512Lanes;
+template <class Scalar>
+struct Avx2Lanes;
+
+#ifdef __AVX512F__
+template <>
+struct Avx512Lanes<double> {
+  using Scalar = double;
+  using Register = __m512d;
+  using Mask = __mmask8;
+  static const int WIDTH = 8;
+
+  static Register Load(const double* data) { return _mm512_loadu_pd(data); }
+  static void Store(double* data, Register value) {
+    _mm512_storeu_pd(data, value);
+  }
+  static Register Broadcast(double value) { return _mm512_set1_pd(value); }
+  static Register Add(Register a, Register b) { return _mm512_add_pd(a, b); }
+  static Register Sub(Register a, Register b) { return _mm512_sub_pd(a, b); }
+  static Register Mul(Register a, Register b) { return _mm512_mul_pd(a, b); }
+  static Register Div(Register a, Register b) { return _mm512_div_pd(a, b); }
+  static Register Sqrt(Register a) { return _mm512_sqrt_pd(a); }
+  static Register Min(Register a, Register b) { return _mm512_min_pd(a, b); }
+  static Register Max(Register a, Register b) { return _mm512_max_pd(a, b); }
+
+  static Mask LessOrEqual(Register a, Register b) {
+    return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ);
+  }
+  static Mask NotEqual(Register a, Register b) {
+    return _mm512_cmp_pd_mask(a, b, _CMP_NEQ_OQ);
+  }
+  static Mask And(Mask a, Mask b) { return a & b; }
+  // if_true where mask is set, if_false elsewhere
+  static Register Select(Mask mask, Register if_true, Register if_false) {
+    return _mm512_mask_blend_pd(mask, if_false, if_true);
+  }
+};
+
+template <>
+struct Avx512Lanes<float> {
+  using Scalar = float;
+  using Register = __m512;
+  using Mask = __mmask16;
+  static const int WIDTH = 16;
+
+  static Register Load(const float* data) { return _mm512_loadu_ps(data); }
+  static void Store(float* data, Register value) {
+    _mm512_storeu_ps(data, value);
+  }
+  static Register Broadcast(float value) { return _mm512_set1_ps(value); }
+  static Register Add(Register a, Register b) { return _mm512_add_ps(a, b); }
+  static Register Sub(Register a, Register b) { return _mm512_sub_ps(a, b); }
+  static Register Mul(Register a, Register b) { return _mm512_mul_ps(a, b); }
+  static Register Div(Register a, Register b) { return _mm512_div_ps(a, b); }
+  static Register Sqrt(Register a) { return _mm512_sqrt_ps(a); }
+  static Register Min(Register a, Register b) { return _mm512_min_ps(a, b); }
+  static Register Max(Register a, Register b) { return _mm512_max_ps(a, b); }
+
+  static Mask LessOrEqual(Register a, Register b) {
+    return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ);
+  }
+  static Mask NotEqual(Register a, Register b) {
+    return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_OQ);
+  }
+  static Mask And(Mask a, Mask b) { return a & b; }
+  static Register Select(Mask mask, Register if_true, Register if_false) {
+    return _mm512_mask_blend_ps(mask, if_false, if_true);
+  }
+};
+#endif
+
+#ifdef __AVX2__
+template <>
+struct Avx2Lanes<double> {
+  using Scalar = double;
+  using Register = __m256d;
+  using Mask = __m256d;
+  static const int WIDTH = 4;
+
+  static Register Load(const double* data) { return _mm256_loadu_pd(data); }
+  static void Store(double* data, Register value) {
+    _mm256_storeu_pd(data, value);
+  }
+  static Register Broadcast(double value) { return _mm256_set1_pd(value); }
+  static Register Add(Register a, Register b) { return _mm256_add_pd(a, b); }
+  static Register Sub(Register a, Register b) { return _mm256_sub_pd(a, b); }
+  static Register Mul(Register a, Register b) { return _mm256_mul_pd(a, b); }
+  static Register Div(Register a, Register b) { return _mm256_div_pd(a, b); }
+  static Register Sqrt(Register a) { return _mm256_sqrt_pd(a); }
+  static Register Min(Register a, Register b) { return _mm256_min_pd(a, b); }
+  static Register Max(Register a, Register b) { return _mm256_max_pd(a, b); }
+
+  static Mask LessOrEqual(Register a, Register b) {
+    return _mm256_cmp_pd(a, b, _CMP_LE_OQ);
+  }
+  static Mask NotEqual(Register a, Register b) {
+    return _mm256_cmp_pd(a, b, _CMP_NEQ_OQ);
+  }
+  static Mask And(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+  static Register Select(Mask mask, Register if_true, Register if_false) {
+    return _mm256_blendv_pd(if_false, if_true, mask);
+  }
+};
+
+template <>
+struct Avx2Lanes<float> {
+  using Scalar = float;
+  using Register = __m256;
+  using Mask = __m256;
+  static const int WIDTH = 8;
+
+  static Register Load(const float* data) { return _mm256_loadu_ps(data); }
+  static void Store(float* data, Register value) {
+    _mm256_storeu_ps(data, value);
+  }
+  static Register Broadcast(float value) { return _mm256_set1_ps(value); }
+  static Register Add(Register a, Register b) { return _mm256_add_ps(a, b); }
+  static Register Sub(Register a, Register b) { return _mm256_sub_ps(a, b); }
+  static Register Mul(Register a, Register b) { return _mm256_mul_ps(a, b); }
+  static Register Div(Register a, Register b) { return _mm256_div_ps(a, b); }
+  static Register Sqrt(Register a) { return _mm256_sqrt_ps(a); }
+  static Register Min(Register a, Register b) { return _mm256_min_ps(a, b); }
+  static Register Max(Register a, Register b) { return _mm256_max_ps(a, b); }
+
+  static Mask LessOrEqual(Register a, Register b) {
+    return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+  }
+  static Mask NotEqual(Register a, Register b) {
+    return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ);
+  }
+  static Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+  static Register Select(Mask mask, Register if_true, Register if_false) {
+    return _mm256_blendv_ps(if_false, if_true, mask);
+  }
+};
+#endif
+
+// WIDTH vectors at once, the same operations as Vector
+template <class Lanes>
+struct VectorLanes {
+  using Register = typename Lanes::Register;
+
+  Register x_;
+  Register y_;
+  Register z_;
+};
+
+template <class Lanes>
+VectorLanes<Lanes> operator-(const VectorLanes<Lanes>& first_vector,
+                             const VectorLanes<Lanes>& second_vector) {
+  return {Lanes::Sub(first_vector.x_, second_vector.x_),
+          Lanes::Sub(first_vector.y_, second_vector.y_),
+          Lanes::Sub(first_vector.z_, second_vector.z_)};
+}
+
+template <class Lanes>
+VectorLanes<Lanes> operator+(const VectorLanes<Lanes>& first_vector,
+                             const VectorLanes<Lanes>& second_vector) {
+  return {Lanes::Add(first_vector.x_, second_vector.x_),
+          Lanes::Add(first_vector.y_, second_vector.y_),
+          Lanes::Add(first_vector.z_, second_vector.z_)};
+}
+
+template <class Lanes>
+VectorLanes<Lanes> operator*(typename Lanes::Register constant,
+                             const VectorLanes<Lanes>& vector) {
+  return {Lanes::Mul(constant, vector.x_), Lanes::Mul(constant, vector.y_),
+          Lanes::Mul(constant, vector.z_)};
+}
+
+template <class Lanes>
+typename Lanes::Register ScalarProduct(
+    const VectorLanes<Lanes>& first_vector,
+    const VectorLanes<Lanes>& second_vector) {
+  return Lanes::Add(
+      Lanes::Add(Lanes::Mul(first_vector.x_, second_vector.x_),
+                 Lanes::Mul(first_vector.y_, second_vector.y_)),
+      Lanes::Mul(first_vector.z_, second_vector.z_));
+}
+
+template <class Lanes>
+typename Lanes::Register Module(const VectorLanes<Lanes>& vector) {
+  return Lanes::Sqrt(ScalarProduct(vector, vector));
+}
+
+// distance from point to the segment from begin to begin + vector, the
+// parameter of the closest point is clamped to [0, 1] instead of branching,
+// a degenerate segment gets parameter 0
+template <class Lanes>
+typename Lanes::Register FindDistance(const VectorLanes<Lanes>& point,
+                                      const VectorLanes<Lanes>& begin,
+                                      const VectorLanes<Lanes>& vector) {
+  auto zero = Lanes::Broadcast(0);
+  auto one = Lanes::Broadcast(1);
+  auto length = ScalarProduct(vector, vector);
+  auto parameter = Lanes::Div(Lanes::Sub(ScalarProduct(point, vector),
+                                         ScalarProduct(begin, vector)),
+                              length);
+  parameter = Lanes::Select(Lanes::NotEqual(length, zero), parameter, zero);
+  parameter = Lanes::Min(Lanes::Max(parameter, zero), one);
+  return Module(begin + parameter * vector - point);
+}
+
+template <class Lanes>
+void FindDistancesKernel(
+    const BasicSegmentArrays<typename Lanes::Scalar>& first,
+    const BasicSegmentArrays<typename Lanes::Scalar>& second, size_t begin,
+    size_t end, typename Lanes::Scalar* distances) {
+  using Coordinates = std::vector<typename Lanes::Scalar>;
+  auto load = [](const Coordinates& x, const Coordinates& y,
+                 const Coordinates& z, size_t i) {
+    return VectorLanes<Lanes>{Lanes::Load(&x[i]), Lanes::Load(&y[i]),
+                              Lanes::Load(&z[i])};
+  };
+  auto zero = Lanes::Broadcast(0);
+  auto one = Lanes::Broadcast(1);
+
+  for (size_t i = begin; i < end; i += Lanes::WIDTH) {
+    auto first_begin = load(first.first_x_, first.first_y_, first.first_z_, i);
+    auto first_end =
+        load(first.second_x_, first.second_y_, first.second_z_, i);
+    auto second_begin =
+        load(second.first_x_, second.first_y_, second.first_z_, i);
+    auto second_end =
+        load(second.second_x_, second.second_y_, second.second_z_, i);
+
+    auto u = first_end - first_begin;
+    auto v = second_end - second_begin;
+    auto w0 = first_begin - second_begin;
+
+    auto a = ScalarProduct(u, u);
+    auto b = ScalarProduct(u, v);
+    auto c = ScalarProduct(v, v);
+    auto d = ScalarProduct(u, w0);
+    auto e = ScalarProduct(v, w0);
+
+    // closest points of the lines, they count only if both lie on the
+    // segments, and as in FindDistance they are compared with the ends
+    auto ac = Lanes::Mul(a, c);
+    auto bb = Lanes::Mul(b, b);
+    auto denominator = Lanes::Sub(ac, bb);
+    auto s_closest = Lanes::Div(
+        Lanes::Sub(Lanes::Mul(b, e), Lanes::Mul(c, d)), denominator);
+    auto t_closest = Lanes::Div(
+        Lanes::Sub(Lanes::Mul(a, e), Lanes::Mul(b, d)), denominator);
+    auto inside = Lanes::And(
+        Lanes::And(Lanes::NotEqual(ac, bb),
+                   Lanes::And(Lanes::LessOrEqual(zero, s_closest),
+                              Lanes::LessOrEqual(s_closest, one))),
+        Lanes::And(Lanes::LessOrEqual(zero, t_closest),
+                   Lanes::LessOrEqual(t_closest, one)));
+    auto between_lines = Module(w0 + s_closest * u - t_closest * v);
+
+    auto j1 = FindDistance(first_begin, second_begin, v);
+    auto j2 = FindDistance(first_end, second_begin, v);
+    auto j3 = FindDistance(second_begin, first_begin, u);
+    auto j4 = FindDistance(second_end, first_begin, u);
+    auto between_ends = Lanes::Min(Lanes::Min(j1, j2), Lanes::Min(j3, j4));
+
+    Lanes::Store(distances + i,
+                 Lanes::Select(inside, Lanes::Min(between_lines, between_ends),
+                               between_ends));
+  }
+}
+
+#endif
+
+// distances[i] is the distance between the i-th segments of first and second,
+// both arrays must have the same size. Blocks of segments go through the
+// widest vector kernel the compiler was allowed to use (-mavx512f, -mavx2),
+// the rest through FindDistancesScalar.
+// Kernels exist for float and double, other scalar types are computed one
+// pair at a time.
+template <class Scalar>
+void FindDistances(const BasicSegmentArrays<Scalar>& first,
+                   const BasicSegmentArrays<Scalar>& second,
+                   Scalar* distances) {
+  size_t vectorized = 0;
+  if constexpr (std::is_same<Scalar, double>::value ||
+                std::is_same<Scalar, float>::value) {
+#if defined(__AVX512F__)
+    using Lanes = Avx512Lanes<Scalar>;
+#elif defined(__AVX2__)
+    using Lanes = Avx2Lanes<Scalar>;
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+    vectorized = first.Size() - first.Size() % Lanes::WIDTH;
+    FindDistancesKernel<Lanes>(first, second, 0, vectorized, distances);
+#endif
+  }
+  FindDistancesScalar(first, second, vectorized, first.Size(), distances);
+}
+
+// Bounding volume hierarchy over segments for queries about all pairs of them
+// at once. Every node is the bounding box of its segments, the segments are
+// split by the median of their centers along the longest side, leaves hold at
+// most LEAF_SIZE_ segments. Queries walk pairs of nodes and skip a pair when
+// the boxes are farther apart than the current bound, the remaining pairs of
+// segments are checked with FindDistance.
+class SegmentHierarchy {
+ public:
+  struct SegmentPair {
+    int first_ = -1;
+    int second_ = -1;
+    double distance_ = std::numeric_limits<double>::infinity();
+  };
+
+  explicit SegmentHierarchy(const std::vector<Segment>& segments,
+                            int number_of_threads = 1);
+
+  // closest pair of segments, first_ == -1 if there are less than two
+  SegmentPair FindClosestPair(int number_of_threads = 1) const;
+  // all pairs at distance at most radius in no particular order, the
+  // indices in a pair are increasing
+  std::vector<SegmentPair> FindPairsWithin(double radius,
+                                           int number_of_threads = 1) const;
+
+ private:
+  static const int LEAF_SIZE_ = 4;
+  // parallel queries split the work into this many pairs of nodes per thread
+  static const int TASKS_PER_THREAD_ = 16;
+
+  struct Box {
+    double min_[3];
+    double max_[3];
+  };
+
+  // segments of a node are segments_[begin_] .. segments_[end_ - 1], the left
+  // child of an inner node directly follows it
+  struct Node {
+    Box box_;
+    int begin_;
+    int end_;
+    int right_;
+  };
+
+  static int NumberOfNodes(int number_of_segments) {
+    if (number_of_segments <= LEAF_SIZE_) {
+      return 1;
+    }
+    int half = number_of_segments / 2;
+    return 1 + NumberOfNodes(half) + NumberOfNodes(number_of_segments - half);
+  }
+  static double DistanceSquared(const Box& first_box, const Box& second_box);
+
+  bool IsLeaf(int node) const {
+    return nodes_[node].end_ - nodes_[node].begin_ <= LEAF_SIZE_;
+  }
+
+  void Build(int node, int begin, int end,
+             const std::vector<Segment>& segments,
+             const std::vector<Point>& centers, int number_of_threads);
+
+  // calls on_pair(i, j) for every pair of segments i < j from the subtrees of
+  // the given nodes that is not pruned by get_bound()
+  template <class GetBound, class OnPair>
+  void Traverse(int first_node, int second_node, GetBound get_bound,
+                OnPair on_pair) const;
+  // pairs of nodes that together cover all the pairs of segments
+  std::vector<std::pair<int, int>> SplitWork(size_t number_of_tasks) const;
+
+  // segments in the order of leaves and their indices in the input
+  std::vector<Segment> segments_;
+  std::vector<int> order_;
+  std::vector<Node> nodes_;
+};
+
+SegmentHierarchy::SegmentHierarchy(const std::vector<Segment>& segments,
+                                   int number_of_threads) {
+  std::vector<Point> centers;
+  centers.reserve(segments.size());
+  for (auto&& segment : segments) {
+    centers.push_back(0.5 * (segment.first_point_ + segment.second_point_));
+  }
+  order_.resize(segments.size());
+  for (size_t i = 0; i < segments.size(); ++i) {
+    order_[i] = i;
+  }
+
+  if (!segments.empty()) {
+    nodes_.resize(NumberOfNodes(segments.size()));
+    Build(0, 0, segments.size(), segments, centers, number_of_threads);
+  }
+
+  segments_.reserve(segments.size());
+  for (auto&& index : order_) {
+    segments_.push_back(segments[index]);
+  }
+}
+
+double SegmentHierarchy::DistanceSquared(const Box& first_box,
+                                         const Box& second_box) {
+  double result = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    double gap = std::max({0.0, first_box.min_[axis] - second_box.max_[axis],
+                           second_box.min_[axis] - first_box.max_[axis]});
+    result += gap * gap;
+  }
+  return result;
+}
+
+void SegmentHierarchy::Build(int node, int begin, int end,
+                             const std::vector<Segment>& segments,
+                             const std::vector<Point>& centers,
+                             int number_of_threads) {
+  Node& current = nodes_[node];
+  current.begin_ = begin;
+  current.end_ = end;
+  Box& box = current.box_;
+
+  if (end - begin <= LEAF_SIZE_) {
+    current.right_ = -1;
+    for (int axis = 0; axis < 3; ++axis) {
+      box.min_[axis] = std::numeric_limits<double>::infinity();
+      box.max_[axis] = -std::numeric_limits<double>::infinity();
+    }
+    for (int i = begin; i < end; ++i) {
+      for (auto&& point : {segments[order_[i]].first_point_,
+                           segments[order_[i]].second_point_}) {
+        double coordinates[] = {point.x_, point.y_, point.z_};
+        for (int axis = 0; axis < 3; ++axis) {
+          box.min_[axis] = std::min(box.min_[axis], coordinates[axis]);
+          box.max_[axis] = std::max(box.max_[axis], coordinates[axis]);
+        }
+      }
+    }
+    return;
+  }
+
+  // split along the longest side of the box of centers
+  Point low = centers[order_[begin]];
+  Point high = low;
+  for (int i = begin; i < end; ++i) {
+    const Point& center = centers[order_[i]];
+    low = Point(std::min(low.x_, center.x_), std::min(low.y_, center.y_),
+                std::min(low.z_, center.z_));
+    high = Point(std::max(high.x_, center.x_), std::max(high.y_, center.y_),
+                 std::max(high.z_, center.z_));
+  }
+  Vector size = high - low;
+  double Point::*axis = &Point::x_;
+  if (size.y_ > size.x_ && size.y_ >= size.z_) {
+    axis = &Point::y_;
+  } else if (size.z_ > size.x_ && size.z_ > size.y_) {
+    axis = &Point::z_;
+  }
+
+  int middle = begin + (end - begin) / 2;
+  std::nth_element(order_.begin() + begin, order_.begin() + middle,
+                   order_.begin() + end,
+                   [&centers, axis](int first, int second) {
+                     return centers[first].*axis < centers[second].*axis;
+                   });
+
+  // the subtrees occupy known ranges of nodes_, so they can be built at the
+  // same time
+  int left = node + 1;
+  current.right_ = left + NumberOfNodes(middle - begin);
+  if (number_of_threads > 1) {
+    std::thread thread([&]() {
+      Build(left, begin, middle, segments, centers, number_of_threads / 2);
+    });
+    Build(current.right_, middle, end, segments, centers,
+          number_of_threads - number_of_threads / 2);
+    thread.join();
+  } else {
+    Build(left, begin, middle, segments, centers, 1);
+    Build(current.right_, middle, end, segments, centers, 1);
+  }
+
+  const Box& left_box = nodes_[left].box_;
+  const Box& right_box = nodes_[current.right_].box_;
+  for (int axis = 0; axis < 3; ++axis) {
+    box.min_[axis] = std::min(left_box.min_[axis], right_box.min_[axis]);
+    box.max_[axis] = std::max(left_box.max_[axis], right_box.max_[axis]);
+  }
+}
+
+template <class GetBound, class OnPair>
+void SegmentHierarchy::Traverse(int first_node, int second_node,
+                                GetBound get_bound, OnPair on_pair) const {
+  std::vector<std::pair<int, int>> stack = {{first_node, second_node}};
+  while (!stack.empty()) {
+    int first = stack.back().first;
+    int second = stack.back().second;
+    stack.pop_back();
+
+    double bound = get_bound();
+    if (DistanceSquared(nodes_[first].box_, nodes_[second].box_) >
+        bound * bound) {
+      continue;
+    }
+
+    bool is_first_leaf = IsLeaf(first);
+    bool is_second_leaf = IsLeaf(second);
+    if (is_first_leaf && is_second_leaf) {
+      for (int i = nodes_[first].begin_; i < nodes_[first].end_; ++i) {
+        int j = first == second ? i + 1 : nodes_[second].begin_;
+        for (; j < nodes_[second].end_; ++j) {
+          on_pair(i, j);
+        }
+      }
+      continue;
+    }
+
+    // pairs inside one node are pushed last, so they are checked first and
+    // give a close bound early
+    if (first == second) {
+      stack.emplace_back(first + 1, nodes_[first].right_);
+      stack.emplace_back(first + 1, first + 1);
+      stack.emplace_back(nodes_[first].right_, nodes_[first].right_);
+      continue;
+    }
+    // split the bigger node
+    if (is_second_leaf ||
+        (!is_first_leaf &&
+         nodes_[first].end_ - nodes_[first].begin_ >=
+             nodes_[second].end_ - nodes_[second].begin_)) {
+      stack.emplace_back(first + 1, second);
+      stack.emplace_back(nodes_[first].right_, second);
+    } else {
+      stack.emplace_back(first, second + 1);
+      stack.emplace_back(first, nodes_[second].right_);
+    }
+  }
+}
+
+std::vector<std::pair<int, int>> SegmentHierarchy::SplitWork(
+    size_t number_of_tasks) const {
+  // breadth-first expansion of the pair (root, root) the same way as in
+  // Traverse, pairs of leaves are final
+  std::vector<std::pair<int, int>> tasks = {{0, 0}};
+  size_t next = 0;
+  std::vector<std::pair<int, int>> result;
+  while (next < tasks.size() &&
+         result.size() + tasks.size() - next < number_of_tasks) {
+    int first = tasks[next].first;
+    int second = tasks[next].second;
+    ++next;
+    if (IsLeaf(first) && IsLeaf(second)) {
+      result.emplace_back(first, second);
+    } else if (first == second) {
+      tasks.emplace_back(first + 1, first + 1);
+      tasks.emplace_back(nodes_[first].right_, nodes_[first].right_);
+      tasks.emplace_back(first + 1, nodes_[first].right_);
+    } else if (IsLeaf(second) ||
+               (!IsLeaf(first) &&
+                nodes_[first].end_ - nodes_[first].begin_ >=
+                    nodes_[second].end_ - nodes_[second].begin_)) {
+      tasks.emplace_back(first + 1, second);
+      tasks.emplace_back(nodes_[first].right_, second);
+    } else {
+      tasks.emplace_back(first, second + 1);
+      tasks.emplace_back(first, nodes_[second].right_);
+    }
+  }
+  result.insert(result.end(), tasks.begin() + next, tasks.end());
+  return result;
+}
+
+SegmentHierarchy::SegmentPair SegmentHierarchy::FindClosestPair(
+    int number_of_threads) const {
+  if (segments_.size() < 2) {
+    return SegmentPair();
+  }
+  number_of_threads = std::max(number_of_threads, 1);
+
+  // the best distance found by any thread prunes all of them
+  std::atomic<double> best_distance(std::numeric_limits<double>::infinity());
+  std::vector<SegmentPair> best(number_of_threads);
+  std::vector<std::pair<int, int>> tasks =
+      SplitWork(number_of_threads == 1 ? 1
+                                       : number_of_threads * TASKS_PER_THREAD_);
+  std::atomic<size_t> next_task(0);
+
+  auto work = [&](SegmentPair& result) {
+    auto get_bound = [&best_distance]() {
+      return best_distance.load(std::memory_order_relaxed);
+    };
+    auto on_pair = [&](int i, int j) {
+      double distance = FindDistance(segments_[i], segments_[j]);
+      if (distance >= result.distance_) {
+        return;
+      }
+      result.first_ = std::min(order_[i], order_[j]);
+      result.second_ = std::max(order_[i], order_[j]);
+      result.distance_ = distance;
+      double current = best_distance.load(std::memory_order_relaxed);
+      while (distance < current &&
+             !best_distance.compare_exchange_weak(current, distance)) {
+      }
+    };
+    for (size_t task = next_task++; task < tasks.size(); task = next_task++) {
+      Traverse(tasks[task].first, tasks[task].second, get_bound, on_pair);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < number_of_threads; ++i) {
+    threads.emplace_back(work, std::ref(best[i]));
+  }
+  work(best[0]);
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+
+  SegmentPair result;
+  for (auto&& pair : best) {
+    if (pair.first_ != -1 &&
+        (result.first_ == -1 || pair.distance_ < result.distance_)) {
+      result = pair;
+    }
+  }
+  return result;
+}
+
+std::vector<SegmentHierarchy::SegmentPair> SegmentHierarchy::FindPairsWithin(
+    double radius, int number_of_threads) const {
+  if (segments_.size() < 2) {
+    return {};
+  }
+  number_of_threads = std::max(number_of_threads, 1);
+
+  std::vector<std::vector<SegmentPair>> found(number_of_threads);
+  std::vector<std::pair<int, int>> tasks =
+      SplitWork(number_of_threads == 1 ? 1
+                                       : number_of_threads * TASKS_PER_THREAD_);
+  std::atomic<size_t> next_task(0);
+
+  auto work = [&](std::vector<SegmentPair>& result) {
+    auto get_bound = [radius]() { return radius; };
+    auto on_pair = [&](int i, int j) {
+      double distance = FindDistance(segments_[i], segments_[j]);
+      if (distance <= radius) {
+        SegmentPair pair;
+        pair.first_ = std::min(order_[i], order_[j]);
+        pair.second_ = std::max(order_[i], order_[j]);
+        pair.distance_ = distance;
+        result.push_back(pair);
+      }
+    };
+    for (size_t task = next_task++; task < tasks.size(); task = next_task++) {
+      Traverse(tasks[task].first, tasks[task].second, get_bound, on_pair);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < number_of_threads; ++i) {
+    threads.emplace_back(work, std::ref(found[i]));
+  }
+  work(found[0]);
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<SegmentPair> result;
+  for (auto&& part : found) {
+    result.insert(result.end(), part.begin(), part.end());
+  }
+  return result;
+}
+
 int main() {
   Point first_point;
   Point second_point;
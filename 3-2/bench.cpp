@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+// the classes of the solution, its main is renamed out of the way
+#define main SolveFromInput
+#include "main.cpp"
+#undef main
+
+// Random point sets with distinct integer coordinates below 2^28, numbered
+// in a random order.
+class PointGenerator {
+ public:
+  explicit PointGenerator(unsigned seed) : generator_(seed) {}
+
+  // uniform in a cube, most of the points are inside the hull
+  std::vector<Point> Cube(size_t size) {
+    std::uniform_int_distribution<int> coordinate(-RANGE_, RANGE_);
+    std::vector<Point> points(size);
+    for (auto&& point : points) {
+      point = Point(coordinate(generator_), coordinate(generator_),
+                    coordinate(generator_));
+    }
+    return Finish(points);
+  }
+
+  // near a sphere, every point is on the hull or almost
+  std::vector<Point> Sphere(size_t size) {
+    std::normal_distribution<double> coordinate;
+    std::vector<Point> points(size);
+    for (auto&& point : points) {
+      double x = coordinate(generator_);
+      double y = coordinate(generator_);
+      double z = coordinate(generator_);
+      double scale = RANGE_ / std::sqrt(x * x + y * y + z * z);
+      point = Point(std::round(x * scale), std::round(y * scale),
+                    std::round(z * scale));
+    }
+    return Finish(points);
+  }
+
+  // NUMBER_OF_CLUSTERS_ normal clouds around random centers in the cube
+  std::vector<Point> Clustered(size_t size) {
+    std::uniform_int_distribution<int> center(-RANGE_ / 2, RANGE_ / 2);
+    std::vector<Point> centers(NUMBER_OF_CLUSTERS_);
+    for (auto&& point : centers) {
+      point = Point(center(generator_), center(generator_), center(generator_));
+    }
+    std::normal_distribution<double> offset(0, RANGE_ / 64);
+    auto coordinate = [&](double center) {
+      return std::max<double>(-RANGE_, std::min<double>(
+          RANGE_, std::round(center + offset(generator_))));
+    };
+    std::vector<Point> points(size);
+    for (auto&& point : points) {
+      const Point& around = centers[generator_() % centers.size()];
+      point = Point(coordinate(around.x_), coordinate(around.y_),
+                    coordinate(around.z_));
+    }
+    return Finish(points);
+  }
+
+  // on the faces of a small integer box, so many points are coplanar
+  std::vector<Point> BoxFaces(size_t size) {
+    std::uniform_int_distribution<int> coordinate(0, BOX_SIZE_);
+    std::vector<Point> points(size);
+    for (auto&& point : points) {
+      int coordinates[3] = {coordinate(generator_), coordinate(generator_),
+                            coordinate(generator_)};
+      coordinates[generator_() % 3] = generator_() % 2 * BOX_SIZE_;
+      point = Point(coordinates[0], coordinates[1], coordinates[2]);
+    }
+    return Finish(points);
+  }
+
+ private:
+  constexpr static const int RANGE_ = 1 << 28;
+  constexpr static const int NUMBER_OF_CLUSTERS_ = 16;
+  constexpr static const int BOX_SIZE_ = 1000;
+
+  // drops repeated points, shuffles and numbers the rest
+  std::vector<Point> Finish(std::vector<Point>& points) {
+    auto key = [](const Point& point) {
+      return std::make_tuple(point.x_, point.y_, point.z_);
+    };
+    std::sort(points.begin(), points.end(),
+              [&key](const Point& first, const Point& second) {
+                return key(first) < key(second);
+              });
+    points.erase(std::unique(points.begin(), points.end(),
+                             [&key](const Point& first, const Point& second) {
+                               return key(first) == key(second);
+                             }),
+                 points.end());
+    std::shuffle(points.begin(), points.end(), generator_);
+    for (size_t i = 0; i < points.size(); ++i) {
+      points[i].id_ = i;
+    }
+    return points;
+  }
+
+  std::mt19937 generator_;
+};
+
+// the fastest of the runs of function, in seconds
+template <class Function>
+double BestTime(int runs, Function function) {
+  double result = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    result = std::min(result, std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count());
+  }
+  return result;
+}
+
+// The kinetic engine on random points in a cube with one thread and with
+// number_of_threads, best of three builds each. The faces must not depend
+// on the number of threads.
+class ThreadsBenchmark {
+ public:
+  ThreadsBenchmark(size_t size, int number_of_threads)
+      : size_(size), number_of_threads_(number_of_threads) {}
+
+  bool operator()() {
+    std::vector<Point> points = PointGenerator(5).Cube(size_);
+    std::vector<ConvexHull::Face> faces[2];
+    int threads[2] = {1, number_of_threads_};
+    for (int i = 0; i < 2; ++i) {
+      ConvexHull hull;
+      double time = BestTime(3, [&]() {
+        hull.Rebuild(points, threads[i], ConvexHull::KINETIC_);
+      });
+      faces[i] = hull.Faces();
+      printf("%zu points, %d threads: %.3f s\n", points.size(), threads[i],
+             time);
+    }
+    if (faces[0] != faces[1]) {
+      printf("the faces depend on the number of threads\n");
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  size_t size_;
+  int number_of_threads_;
+};
+
+// Both engines in one thread on each point distribution, and the automatic
+// choice with AUTOMATIC_THREADS_, best of three builds each.
+class EnginesBenchmark {
+ public:
+  explicit EnginesBenchmark(size_t size) : size_(size) {}
+
+  void operator()() {
+    PointGenerator generator(6);
+    Run("cube", generator.Cube(size_));
+    Run("sphere", generator.Sphere(size_));
+    Run("clustered", generator.Clustered(size_));
+    Run("box faces", generator.BoxFaces(size_));
+  }
+
+ private:
+  constexpr static const int AUTOMATIC_THREADS_ = 4;
+
+  static void Run(const char* name, const std::vector<Point>& points) {
+    ConvexHull hull;
+    double times[3];
+    ConvexHull::Engine engines[3] = {
+        ConvexHull::KINETIC_, ConvexHull::INCREMENTAL_, ConvexHull::AUTOMATIC_};
+    int threads[3] = {1, 1, AUTOMATIC_THREADS_};
+    for (int i = 0; i < 3; ++i) {
+      times[i] = BestTime(
+          3, [&]() { hull.Rebuild(points, threads[i], engines[i]); });
+    }
+    printf("%-10s %zu points: kinetic %9.1f ms, incremental %9.1f ms, "
+           "automatic in %d threads %9.1f ms\n",
+           name, points.size(), 1e3 * times[0], 1e3 * times[1],
+           AUTOMATIC_THREADS_, 1e3 * times[2]);
+  }
+
+  size_t size_;
+};
+
+// The top-level merge of the kinetic engine alone. The halves are built
+// once in both passes, then their frames are restored and the merge,
+// FindSupportingRib and ProcessStates, is run again on the events of the
+// halves, best of NUMBER_OF_RUNS_. The time is per event the merge reads
+// (of the halves) or writes (of the whole), lower and upper passes
+// together. The full kinetic build is printed for scale.
+class MergeBenchmark {
+ public:
+  explicit MergeBenchmark(size_t size) : size_(size) {}
+
+  bool operator()() {
+    PointGenerator generator(7);
+    return Run("cube", generator.Cube(size_)) &&
+           Run("sphere", generator.Sphere(size_)) &&
+           Run("clustered", generator.Clustered(size_));
+  }
+
+ private:
+  constexpr static const int NUMBER_OF_RUNS_ = 20;
+
+  static bool Run(const char* name, const std::vector<Point>& points) {
+    ConvexHull hull;
+    double build_time = BestTime(3, [&]() {
+      hull.Rebuild(points, 1, ConvexHull::KINETIC_);
+    });
+
+    // the state of BuildKinetic before its last merge
+    hull.points_ = points;
+    hull.number_of_vertices_ = points.size();
+    hull.perturbation_order_.clear();
+    std::sort(hull.points_.begin(), hull.points_.end(),
+              [](const Point& first, const Point& second) {
+                return first.x_ < second.x_;
+              });
+    double merge_time = 0;
+    size_t number_of_events = 0;
+    for (ConvexHull::Pass* pass : {&hull.lower_pass_, &hull.upper_pass_}) {
+      size_t events = 0;
+      double time = MergeTime(hull, *pass, events);
+      if (time < 0) {
+        printf("the merge differs from the one of DownHull\n");
+        return false;
+      }
+      merge_time += time;
+      number_of_events += events;
+    }
+    printf("%-10s %zu points: build %8.1f ms, top merge %6.2f ms, %zu "
+           "events, %.0f ns per event\n",
+           name, points.size(), 1e3 * build_time, 1e3 * merge_time,
+           number_of_events, 1e9 * merge_time / number_of_events);
+    return true;
+  }
+
+  // the best time of the top-level merge of the pass as in DownHull, or -1
+  // when its events differ from those of the whole DownHull
+  static double MergeTime(ConvexHull& hull, ConvexHull::Pass& pass,
+                          size_t& number_of_events) {
+    int size = hull.number_of_vertices_;
+    int middle = size / 2;
+    pass.Reset(size);
+    int* events = pass.events_.data();
+    int* left_events = pass.buffer_.data();
+    int* right_events = left_events + 2 * middle;
+    hull.DownHull(pass, 0, middle, left_events, events, 1);
+    hull.DownHull(pass, middle, size, right_events, events + 2 * middle, 1);
+    std::vector<int> prev = pass.prev_;
+    std::vector<int> next = pass.next_;
+    number_of_events = Length(left_events) + Length(right_events);
+
+    double result = std::numeric_limits<double>::infinity();
+    int merged_events = 0;
+    for (int i = 0; i < NUMBER_OF_RUNS_; ++i) {
+      pass.prev_ = prev;
+      pass.next_ = next;
+      auto start = std::chrono::steady_clock::now();
+      int u = middle - 1;
+      int v = middle;
+      hull.FindSupportingRib(pass, u, v);
+      merged_events =
+          hull.ProcessStates(pass, u, v, left_events, right_events, events);
+      result = std::min(result, std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count());
+    }
+    number_of_events += merged_events;
+
+    std::vector<int> merged(events, events + merged_events);
+    merged.push_back(ConvexHull::NIL_);
+    pass.Reset(size);
+    hull.InitializeDownHull(pass, 1);
+    if (!std::equal(merged.begin(), merged.end(), pass.events_.begin())) {
+      return -1;
+    }
+    return result;
+  }
+
+  static size_t Length(const int* events) {
+    size_t result = 0;
+    while (events[result] != ConvexHull::NIL_) {
+      ++result;
+    }
+    return result;
+  }
+
+  size_t size_;
+};
+
+// Insert on random points in a cube, the points inserted without ids: into
+// an empty hull and into the hull of the first half of the points. The
+// faces must refer to the points by their numbers and match the hull built
+// at once.
+class InsertBenchmark {
+ public:
+  explicit InsertBenchmark(size_t size) : size_(size) {}
+
+  bool operator()() {
+    std::vector<Point> points = PointGenerator(8).Cube(size_);
+    std::vector<ConvexHull::Face> faces = ConvexHull(points).Faces();
+    return Run(points, 0, faces) && Run(points, points.size() / 2, faces);
+  }
+
+ private:
+  static bool Run(const std::vector<Point>& points, size_t initial_size,
+                  const std::vector<ConvexHull::Face>& faces) {
+    ConvexHull hull(std::vector<Point>(points.begin(),
+                                       points.begin() + initial_size));
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = initial_size; i < points.size(); ++i) {
+      hull.Insert(Point(points[i].x_, points[i].y_, points[i].z_));
+    }
+    double time = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    printf("%zu points inserted into %zu: %.2f us per point\n",
+           points.size() - initial_size, initial_size,
+           1e6 * time / (points.size() - initial_size));
+
+    for (auto&& face : hull.Faces()) {
+      if (std::max({std::get<0>(face), std::get<1>(face),
+                    std::get<2>(face)}) >= points.size()) {
+        printf("a face refers to a point out of range\n");
+        return false;
+      }
+    }
+    if (hull.Faces() != faces) {
+      printf("the faces differ from the hull built at once\n");
+      return false;
+    }
+    return true;
+  }
+
+  size_t size_;
+};
+
+// g++ -std=c++17 -O2 -pthread bench.cpp -o bench &&
+//     ./bench threads [size] [number_of_threads] or ./bench engines [size]
+//     or ./bench merge [size] or ./bench insert [size]
+int main(int argc, char** argv) {
+  const char* mode = argc > 1 ? argv[1] : "threads";
+
+  bool is_correct = true;
+  if (strcmp(mode, "threads") == 0) {
+    ThreadsBenchmark benchmark(argc > 2 ? atol(argv[2]) : 1000000,
+                               argc > 3 ? atoi(argv[3]) : 4);
+    is_correct = benchmark();
+  } else if (strcmp(mode, "engines") == 0) {
+    EnginesBenchmark benchmark(argc > 2 ? atol(argv[2]) : 100000);
+    benchmark();
+  } else if (strcmp(mode, "merge") == 0) {
+    MergeBenchmark benchmark(argc > 2 ? atol(argv[2]) : 100000);
+    is_correct = benchmark();
+  } else if (strcmp(mode, "insert") == 0) {
+    InsertBenchmark benchmark(argc > 2 ? atol(argv[2]) : 100000);
+    is_correct = benchmark();
+  } else {
+    fprintf(stderr, "unknown mode %s\n", mode);
+    return 1;
+  }
+
+  return is_correct ? 0 : 1;
+}
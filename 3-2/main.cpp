@@ -1,70 +1,286 @@
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
 #include <iostream>
-#include <memory>
+#include <random>
+#include <string>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
 
-struct Vector : std::enable_shared_from_this<Vector> {
-  explicit Vector(double x = 0, double y = 0, double z = 0, int id = -1)
-      : x_(x), y_(y), z_(z), id_(id) {}
+// Geometry for any scalar type, so exact or more precise arithmetic can be
+// plugged into the predicates.
+template <class Scalar>
+struct BasicVector {
+  constexpr explicit BasicVector(Scalar x = 0, Scalar y = 0, Scalar z = 0)
+      : x_(x), y_(y), z_(z) {}
 
-  bool Act() {
-    std::shared_ptr<Vector> temp(this);
-    if (prev_->next_ == temp) {
-      prev_->next_ = next_;
-      next_->prev_ = prev_;
-      return false;
-    }
-    prev_->next_ = temp;
-    next_->prev_ = temp;
-    return true;
-  }
+  Scalar x_;
+  Scalar y_;
+  Scalar z_;
+};
+
+template <class Scalar>
+constexpr BasicVector<Scalar> VectorProduct(
+    const BasicVector<Scalar>& first_vector,
+    const BasicVector<Scalar>& second_vector) {
+  return BasicVector<Scalar>(
+      first_vector.y_ * second_vector.z_ - first_vector.z_ * second_vector.y_,
+      first_vector.z_ * second_vector.x_ - first_vector.x_ * second_vector.z_,
+      first_vector.x_ * second_vector.y_ - first_vector.y_ * second_vector.x_);
+}
+
+template <class Scalar>
+constexpr BasicVector<Scalar> operator+(const BasicVector<Scalar>& lhs,
+                                        const BasicVector<Scalar>& rhs) {
+  return BasicVector<Scalar>(lhs.x_ + rhs.x_, lhs.y_ + rhs.y_,
+                             lhs.z_ + rhs.z_);
+}
+
+template <class Scalar>
+constexpr BasicVector<Scalar> operator-(const BasicVector<Scalar>& lhs,
+                                        const BasicVector<Scalar>& rhs) {
+  return BasicVector<Scalar>(lhs.x_ - rhs.x_, lhs.y_ - rhs.y_,
+                             lhs.z_ - rhs.z_);
+}
+
+// point of the input with its index in the input
+struct Vector : BasicVector<double> {
+  explicit Vector(double x = 0, double y = 0, double z = 0, int id = -1)
+      : BasicVector<double>(x, y, z), id_(id) {}
 
-  double x_ = 0;
-  double y_ = 0;
-  double z_ = 0;
   int id_ = -1;
-  std::shared_ptr<Vector> prev_ = nullptr;
-  std::shared_ptr<Vector> next_ = nullptr;
 };
 
 using Point = Vector;
 
-void RotateAroundThirdDimension(double& x, double& y, double angle) {
-  double new_x = 0;
-  double new_y = 0;
+// Exact number perturbed symbolically, a sum of coefficients times powers of
+// an infinitely small d. The variables of the perturbation are d_i = d^(3^i),
+// so d_0 >> d_1 >> ..., and as none of them gets more than squared, different
+// monomials in them are different powers of d. Terms are kept sorted by the
+// exponents without zero coefficients. The numbers are differences of
+// products of differences of coordinates below 2^29, so coefficients fit in
+// 64 bits and there are at most 18 terms.
+struct SymbolicNumber {
+  struct Term {
+    int64_t exponent_;
+    int64_t coefficient_;
+  };
+
+  // lhs + factor * rhs
+  static SymbolicNumber Merge(const SymbolicNumber& lhs,
+                              const SymbolicNumber& rhs, int64_t factor);
 
-  new_x = x * cos(angle) + y * sin(angle);
-  new_y = -x * sin(angle) + y * cos(angle);
-  x = new_x;
-  y = new_y;
+  constexpr static const int MAX_TERMS_ = 18;
+  Term terms_[MAX_TERMS_];
+  int size_ = 0;
+};
+
+SymbolicNumber SymbolicNumber::Merge(const SymbolicNumber& lhs,
+                                     const SymbolicNumber& rhs,
+                                     int64_t factor) {
+  SymbolicNumber result;
+  int first = 0;
+  int second = 0;
+  while (first < lhs.size_ || second < rhs.size_) {
+    Term term;
+    if (second == rhs.size_ ||
+        (first < lhs.size_ &&
+         lhs.terms_[first].exponent_ < rhs.terms_[second].exponent_)) {
+      term = lhs.terms_[first++];
+    } else {
+      term = {rhs.terms_[second].exponent_,
+              factor * rhs.terms_[second].coefficient_};
+      if (first < lhs.size_ &&
+          lhs.terms_[first].exponent_ == term.exponent_) {
+        term.coefficient_ += lhs.terms_[first++].coefficient_;
+      }
+      ++second;
+    }
+    if (term.coefficient_ != 0) {
+      result.terms_[result.size_++] = term;
+    }
+  }
+  return result;
 }
 
-Vector VectorProduct(const Vector& first_vector, const Vector& second_vector) {
-  return Vector(
-      first_vector.y_ * second_vector.z_ - first_vector.z_ * second_vector.y_,
-      first_vector.z_ * second_vector.x_ - first_vector.x_ * second_vector.z_,
-      first_vector.x_ * second_vector.y_ - first_vector.y_ * second_vector.x_);
+SymbolicNumber operator-(const SymbolicNumber& lhs, const SymbolicNumber& rhs) {
+  return SymbolicNumber::Merge(lhs, rhs, -1);
+}
+
+// only multiplies differences of coordinates, so all products fit
+SymbolicNumber operator*(const SymbolicNumber& lhs, const SymbolicNumber& rhs) {
+  SymbolicNumber result;
+  // the products are sorted by insertion, then equal exponents are joined
+  for (int i = 0; i < lhs.size_; ++i) {
+    for (int j = 0; j < rhs.size_; ++j) {
+      SymbolicNumber::Term term = {
+          lhs.terms_[i].exponent_ + rhs.terms_[j].exponent_,
+          lhs.terms_[i].coefficient_ * rhs.terms_[j].coefficient_};
+      int position = result.size_++;
+      while (position > 0 &&
+             result.terms_[position - 1].exponent_ > term.exponent_) {
+        result.terms_[position] = result.terms_[position - 1];
+        --position;
+      }
+      result.terms_[position] = term;
+    }
+  }
+  int size = 0;
+  for (int i = 0; i < result.size_; ++i) {
+    if (size > 0 &&
+        result.terms_[size - 1].exponent_ == result.terms_[i].exponent_) {
+      result.terms_[size - 1].coefficient_ += result.terms_[i].coefficient_;
+    } else {
+      if (size > 0 && result.terms_[size - 1].coefficient_ == 0) {
+        --size;
+      }
+      result.terms_[size++] = result.terms_[i];
+    }
+  }
+  if (size > 0 && result.terms_[size - 1].coefficient_ == 0) {
+    --size;
+  }
+  result.size_ = size;
+  return result;
 }
 
-Point operator+(const Point& lhs, const Point& rhs) {
-  return Point(lhs.x_ + rhs.x_, lhs.y_ + rhs.y_, lhs.z_ + rhs.z_);
+// The sign of the sum of signs[i] * first[i] * second[i] over at most three
+// products for an infinitely small d. Terms of the products are walked from
+// the least exponent with a heap of cursors, and the walk stops at the first
+// exponent with a nonzero sum.
+int SignOfSum(const SymbolicNumber* const* first,
+              const SymbolicNumber* const* second, const int* signs,
+              int number_of_products) {
+  struct Cursor {
+    int64_t exponent_;
+    const SymbolicNumber::Term* term_;
+    const SymbolicNumber::Term* other_term_;
+    const SymbolicNumber::Term* other_end_;
+    bool is_subtracted_;
+  };
+  auto is_later = [](const Cursor& lhs, const Cursor& rhs) {
+    return lhs.exponent_ > rhs.exponent_;
+  };
+
+  Cursor heap[3 * SymbolicNumber::MAX_TERMS_];
+  int heap_size = 0;
+  auto add_cursors = [&](const SymbolicNumber& lhs, const SymbolicNumber& rhs,
+                         bool is_subtracted) {
+    if (rhs.size_ == 0) {
+      return;
+    }
+    for (int i = 0; i < lhs.size_; ++i) {
+      heap[heap_size++] = {lhs.terms_[i].exponent_ + rhs.terms_[0].exponent_,
+                           lhs.terms_ + i, rhs.terms_, rhs.terms_ + rhs.size_,
+                           is_subtracted};
+    }
+  };
+  for (int i = 0; i < number_of_products; ++i) {
+    add_cursors(*first[i], *second[i], signs[i] < 0);
+  }
+  std::make_heap(heap, heap + heap_size, is_later);
+
+  __int128 sum = 0;
+  int64_t exponent = 0;
+  while (heap_size != 0) {
+    std::pop_heap(heap, heap + heap_size, is_later);
+    Cursor& cursor = heap[heap_size - 1];
+    if (cursor.exponent_ != exponent) {
+      if (sum != 0) {
+        break;
+      }
+      exponent = cursor.exponent_;
+    }
+    __int128 product =
+        static_cast<__int128>(cursor.term_->coefficient_) *
+        cursor.other_term_->coefficient_;
+    sum += cursor.is_subtracted_ ? -product : product;
+
+    if (++cursor.other_term_ == cursor.other_end_) {
+      --heap_size;
+    } else {
+      cursor.exponent_ =
+          cursor.term_->exponent_ + cursor.other_term_->exponent_;
+      std::push_heap(heap, heap + heap_size, is_later);
+    }
+  }
+  return sum < 0 ? -1 : (sum > 0 ? 1 : 0);
 }
 
-Point operator-(const Point& lhs, const Point& rhs) {
-  return Point(lhs.x_ - rhs.x_, lhs.y_ - rhs.y_, lhs.z_ - rhs.z_);
+// the sign of first * second - third * fourth for an infinitely small d
+int SignOfDifference(const SymbolicNumber& first, const SymbolicNumber& second,
+                     const SymbolicNumber& third,
+                     const SymbolicNumber& fourth) {
+  const SymbolicNumber* lhs[2] = {&first, &third};
+  const SymbolicNumber* rhs[2] = {&second, &fourth};
+  int signs[2] = {1, -1};
+  return SignOfSum(lhs, rhs, signs, 2);
 }
 
 class ConvexHull {
  public:
-  explicit ConvexHull(std::vector<Point> point);
+  // The algorithm building the hull. The kinetic one is the divide and
+  // conquer on the points sorted by x, the incremental one adds the points in
+  // random order and keeps for every point outside the hull a face it sees,
+  // so the points found inside are never looked at again. In one thread the
+  // incremental one is faster, the automatic choice takes the kinetic one
+  // only when it has threads for a big set. On points with many equal
+  // coordinates (grids, boxes, CAD models) the times of the kinetic events
+  // tie and are compared symbolically, which makes it tens of times slower,
+  // so such sets always go to the incremental one.
+  enum Engine { AUTOMATIC_, KINETIC_, INCREMENTAL_ };
 
-  void Print();
+  // Points must be distinct with integer coordinates below 2^29 by absolute
+  // value. With several threads the kinetic engine builds the lower and
+  // upper hulls at the same time, and so the halves of big merges, the
+  // incremental one always works in one thread.
+  //
+  // The predicates are exact: doubles with error bounds decide almost all of
+  // them and the rest is computed in __int128. Degenerate inputs are
+  // perturbed symbolically: coordinate k of the i-th point is decreased by an
+  // infinitely small e_(3i + k), e_0 >> e_1 >> .... Then no two points have
+  // equal x, no three lie in a vertical plane or on a line and no four are
+  // coplanar, while faces of the perturbed hull triangulate the faces of the
+  // real one. The points are numbered in the order of x for the kinetic
+  // engine and in the order of the input for the incremental one.
+  explicit ConvexHull(std::vector<Point> points, int number_of_threads = 1,
+                      Engine engine = AUTOMATIC_);
+  // an empty hull to be rebuilt, a workspace for many small hulls
+  ConvexHull();
 
- private:
+  // builds the hull of other points in the memory of this one
+  void Rebuild(const std::vector<Point>& points, int number_of_threads = 1,
+               Engine engine = AUTOMATIC_);
+
+  // Adds a point distinct from the others. A point without an id (id_ < 0)
+  // gets the number of points before it, as if it came last in the input.
+  // The first insertion builds the hull again with the incremental engine
+  // keeping the history of the faces: the faces replacing a face are its
+  // children. A point seeing a face sees one of the faces it replaced, so
+  // the faces seen from a new point are found down the history from the
+  // first tetrahedron, in expected O(log n) for points coming in random
+  // order, or among the faces of the last insertion for points coming one
+  // near the other.
+  void Insert(const Point& point);
+
+  // indices of the points of a face, counterclockwise seen from outside and
+  // starting from the least one
   using Face = std::tuple<size_t, size_t, size_t>;
+  // the faces of the current hull in lexicographic order
+  const std::vector<Face>& Faces() const;
+
+  void Print() const;
+  // appends the hull in the format of Print to output
+  void Print(std::string& output) const;
+
+ private:
+  // times the merge of the kinetic engine alone, in bench.cpp
+  friend class MergeBenchmark;
 
   static void Permute(Face& face) {
     size_t first_point = std::get<0>(face);
@@ -77,260 +293,1194 @@ class ConvexHull {
     }
   }
 
-  void InitializeDownHull(size_t left_size, size_t right_size);
-  std::vector<std::shared_ptr<Point>> DownHull(size_t left_size,
-                                               size_t right_size);
+  // a vertex that is not in the frame, prev and next of the ends of a frame
+  constexpr static const int NIL_ = -1;
+  // smaller merges are not worth a thread
+  constexpr static const int PARALLEL_CUTOFF_ = 1 << 14;
+  // the points looked at for equal coordinates, and how many of the pairs
+  // of equal ones among them make a set degenerate for the kinetic engine
+  constexpr static const int DEGENERACY_SAMPLE_SIZE_ = 1 << 10;
+  constexpr static const int DEGENERACY_THRESHOLD_ = 1 << 6;
+
+  // The movie of the lower hull, or of the upper one with z mirrored. The
+  // frame is a doubly linked list of vertices. A hull of n points has less
+  // than 2n events, events_ gets the events and buffer_ of the same size is
+  // used by the recursion.
+  struct Pass {
+    explicit Pass(bool is_upper) : is_upper_(is_upper) {}
+
+    // empties the frame for number_of_vertices points, keeping the memory
+    void Reset(int number_of_vertices) {
+      prev_.assign(number_of_vertices, NIL_);
+      next_.assign(number_of_vertices, NIL_);
+      events_.resize(2 * number_of_vertices + 1);
+      buffer_.resize(2 * number_of_vertices + 1);
+    }
+
+    bool is_upper_;
+    std::vector<int> prev_;
+    std::vector<int> next_;
+    std::vector<int> events_;
+    std::vector<int> buffer_;
+  };
+
+  // inserts vertex into the frame between its prev and next or removes it
+  // from there, returns whether it was inserted
+  static bool Act(Pass& pass, int vertex);
+
+  // The incremental hull: faces turning counterclockwise seen from outside
+  // with their neighbours, and for every point not added yet a face it sees,
+  // or NIL_ when it is inside. The points seeing a face are a list through
+  // next_conflict_. Dead faces are reused unless the history is kept, and
+  // all of the memory is kept for the next hulls.
+  struct ConflictGraph {
+    struct Facet {
+      int vertices_[3];
+      // the neighbour across the edge from vertices_[i] to vertices_[i + 1]
+      int neighbors_[3];
+      // the normal of the plane rounded to doubles, filters the predicates
+      BasicVector<double> normal_;
+      int first_conflict_;
+      // the faces replacing this one, a list through children_
+      int first_child_;
+      // the insertion that looked at the face last and what it found
+      int visited_;
+      bool is_visible_;
+      bool is_alive_;
+    };
+
+    void Reset(int number_of_vertices) {
+      facets_.clear();
+      free_facets_.clear();
+      children_.clear();
+      new_facets_.clear();
+      conflict_facet_.assign(number_of_vertices, NIL_);
+      next_conflict_.assign(number_of_vertices, NIL_);
+      facet_by_start_.assign(number_of_vertices, NIL_);
+      insertion_ = 0;
+    }
+    void AddConflict(int facet, int point);
+    void AddChild(int facet, int child);
+
+    std::vector<Facet> facets_;
+    std::vector<int> free_facets_;
+    // a child and the next one of the same face
+    std::vector<std::pair<int, int>> children_;
+    std::vector<int> conflict_facet_;
+    std::vector<int> next_conflict_;
+    // the new face starting at a vertex of the horizon
+    std::vector<int> facet_by_start_;
+    // the points before the shuffle
+    std::vector<Point> points_;
+    std::vector<int> visible_;
+    // edges of the horizon as a visible face and the number of the edge
+    std::vector<std::pair<int, int>> horizon_;
+    std::vector<int> new_facets_;
+    int insertion_ = 0;
+    bool keeps_history_ = false;
+  };
+
+  // the order of the insertions is the same for the same input
+  constexpr static const unsigned RANDOM_SEED_ = 5489;
 
-  static bool IsClockwise(const std::shared_ptr<Point>& first_point,
-                          const std::shared_ptr<Point>& second_point,
-                          const std::shared_ptr<Point>& third_point);
-  static double Time(const std::shared_ptr<Point>& first_point,
-                     const std::shared_ptr<Point>& second_point,
-                     const std::shared_ptr<Point>& third_point);
+  // builds the hull of points_
+  void Build(int number_of_threads, Engine engine);
+  // whether evenly spaced points share coordinates often, as on a grid,
+  // where the kinetic events tie
+  bool HasRepeatedCoordinates() const;
+  void BuildKinetic(int number_of_threads);
+  void BuildIncremental(bool keeps_history);
+  // builds the hull of points_ again keeping the history
+  void BuildHistory();
+  // sorts the faces of the kinetic hull or takes the incremental one
+  void UpdateFaces() const;
+  int NewFacet(int first_point, int second_point, int third_point);
+  // a face of the incremental hull seen from the point or NIL_, found down
+  // the history
+  int Locate(int point);
+  // adds a point outside the incremental hull
+  void InsertPoint(int point);
+  bool IsVisible(int facet, int point) const;
+  void InitializeDownHull(Pass& pass, int number_of_threads);
+  // replays the events of the pass and adds the faces they create
+  void AddFaces(Pass& pass);
+  // writes the events of the lower hull of points [left_size, right_size)
+  // to events, terminated by NIL_
+  void DownHull(Pass& pass, int left_size, int right_size, int* events,
+                int* buffer, int number_of_threads);
 
-  static void FindSupportingRib(std::shared_ptr<Point>& u,
-                                std::shared_ptr<Point>& v);
-  static void ProcessStates(
-      std::shared_ptr<Point>& u, std::shared_ptr<Point>& v,
-      std::pair<std::vector<std::shared_ptr<Point>>,
-                std::vector<std::shared_ptr<Point>>>& parts_of_hull,
-      std::vector<std::shared_ptr<Point>> part_of_hull);
+  // The time of an event, numerator / denominator for the triple of points,
+  // or an infinity. Both are exact, the quotient in doubles is off by at
+  // most error_ and decides most comparisons. Times too close for it are
+  // compared in 128 bits, and equal ones symbolically on the points.
+  struct EventTime {
+    double value_ = HUGE_VAL;
+    double error_ = 0;
+    int64_t numerator_ = 0;
+    int64_t denominator_ = 0;
+    int points_[3] = {NIL_, NIL_, NIL_};
+    int denominator_sign_ = 0;
+  };
+
+  // relative error bound of the double quotients
+  constexpr static const double ERROR_BOUND_ = 1e-14;
+
+  // the difference of the points, exact for the integer coordinates
+  BasicVector<int64_t> IntegerVector(int from_point, int to_point) const;
+  // whether first point is to the left of second one after the perturbation
+  bool IsLeftOf(int first_point, int second_point) const;
+  // the turn in the frame at the start of the movie
+  bool IsClockwise(int first_point, int second_point, int third_point) const;
+  EventTime Time(const Pass& pass, int first_point, int second_point,
+                 int third_point) const;
+  bool IsEarlier(const Pass& pass, const EventTime& first,
+                 const EventTime& second) const;
+
+  // the number of the point in the perturbation
+  int PerturbationIndex(int point) const;
+  // Writes the coordinates of the vectors second - first and third - second
+  // of the triple for the perturbed points. Only the order of the e matters
+  // for a sign, so e of the points of a predicate, sorted by their numbers
+  // in the perturbation given in involved, are numbered from d_0.
+  void ExactVectors(const int* points, const int* involved,
+                    int number_of_involved, SymbolicNumber* first_vector,
+                    SymbolicNumber* second_vector) const;
+  int ExactDenominatorSign(const int* points) const;
+  // the sign of the volume of the tetrahedron, positive when the fourth point
+  // sees the first three turning counterclockwise
+  int Orientation(int first_point, int second_point, int third_point,
+                  int fourth_point) const;
+  // the sign of first - second for times too close for the doubles
+  int CompareExactly(const Pass& pass, const EventTime& first,
+                     const EventTime& second) const;
+
+  void FindSupportingRib(const Pass& pass, int& u, int& v) const;
+  // runs the movie of the merge of two halves with events left_events and
+  // right_events, writes the events of the whole to part_of_hull and
+  // returns their number
+  int ProcessStates(Pass& pass, int& u, int& v, const int* left_events,
+                    const int* right_events, int* part_of_hull);
 
-  constexpr static const double INF = 1e9;
   int number_of_vertices_ = 0;
   std::vector<Point> points_;
-  std::vector<Face> hull_;
-  bool is_down_hull_built = false;
+  // the faces, updated lazily after the incremental engine
+  mutable std::vector<Face> hull_;
+  mutable bool are_faces_stale_ = false;
+  Pass lower_pass_;
+  Pass upper_pass_;
+  // the numbers of the points in the perturbation, the indices in points_
+  // when empty
+  std::vector<int> perturbation_order_;
+  ConflictGraph conflict_graph_;
 };
 
-ConvexHull::ConvexHull(std::vector<Point> points) : points_(std::move(points)) {
+ConvexHull::ConvexHull(std::vector<Point> points, int number_of_threads,
+                       Engine engine)
+    : ConvexHull() {
+  points_ = std::move(points);
+  Build(number_of_threads, engine);
+}
+
+ConvexHull::ConvexHull() : lower_pass_(false), upper_pass_(true) {}
+
+void ConvexHull::Rebuild(const std::vector<Point>& points,
+                         int number_of_threads, Engine engine) {
+  points_.assign(points.begin(), points.end());
+  Build(number_of_threads, engine);
+}
+
+void ConvexHull::Build(int number_of_threads, Engine engine) {
   number_of_vertices_ = points_.size();
-  InitializeDownHull(0, number_of_vertices_);
+  hull_.clear();
+  // a hull of n points has at most 2n - 4 faces
+  hull_.reserve(2 * number_of_vertices_);
+
+  if (engine == AUTOMATIC_) {
+    engine = number_of_threads > 1 &&
+                     number_of_vertices_ >= PARALLEL_CUTOFF_ &&
+                     !HasRepeatedCoordinates()
+                 ? KINETIC_
+                 : INCREMENTAL_;
+  }
+  // the incremental hull starts from a tetrahedron
+  conflict_graph_.keeps_history_ = false;
+  if (engine == INCREMENTAL_ && number_of_vertices_ >= 4) {
+    BuildIncremental(false);
+  } else {
+    BuildKinetic(number_of_threads);
+  }
+  are_faces_stale_ = true;
+}
+
+bool ConvexHull::HasRepeatedCoordinates() const {
+  size_t step = std::max<size_t>(points_.size() / DEGENERACY_SAMPLE_SIZE_, 1);
+  std::vector<double> values;
+  int number_of_repeats = 0;
+  for (auto coordinate : {&Point::x_, &Point::y_, &Point::z_}) {
+    values.clear();
+    for (size_t i = 0; i < points_.size(); i += step) {
+      values.push_back(points_[i].*coordinate);
+    }
+    std::sort(values.begin(), values.end());
+    for (size_t i = 1; i < values.size(); ++i) {
+      number_of_repeats += values[i] == values[i - 1];
+    }
+  }
+  return number_of_repeats >= DEGENERACY_THRESHOLD_;
+}
+
+void ConvexHull::Insert(const Point& point) {
+  ConflictGraph& graph = conflict_graph_;
+  points_.push_back(point);
+  if (points_.back().id_ < 0) {
+    points_.back().id_ = points_.size() - 1;
+  }
+  if (!graph.keeps_history_) {
+    BuildHistory();
+    return;
+  }
+
+  // the new point is the last one in the perturbation
+  int index = number_of_vertices_++;
+  perturbation_order_.push_back(index);
+  graph.conflict_facet_.push_back(NIL_);
+  graph.next_conflict_.push_back(NIL_);
+  graph.facet_by_start_.push_back(NIL_);
+  int facet = Locate(index);
+  if (facet != NIL_) {
+    graph.AddConflict(facet, index);
+    InsertPoint(index);
+    are_faces_stale_ = true;
+  }
+}
 
-  for (auto&& point : points_) {
-    point.next_ = nullptr;
-    point.prev_ = nullptr;
-    point.z_ *= -1;
+void ConvexHull::BuildHistory() {
+  number_of_vertices_ = points_.size();
+  hull_.clear();
+  if (number_of_vertices_ >= 4) {
+    BuildIncremental(true);
+  } else {
+    BuildKinetic(1);
   }
-  is_down_hull_built = true;
+  are_faces_stale_ = true;
+}
+
+const std::vector<ConvexHull::Face>& ConvexHull::Faces() const {
+  UpdateFaces();
+  return hull_;
+}
 
-  InitializeDownHull(0, number_of_vertices_);
+void ConvexHull::UpdateFaces() const {
+  if (!are_faces_stale_) {
+    return;
+  }
+  // the kinetic engine fills the faces itself
+  if (!perturbation_order_.empty()) {
+    hull_.clear();
+    for (auto&& facet : conflict_graph_.facets_) {
+      if (facet.is_alive_) {
+        hull_.emplace_back(points_[facet.vertices_[0]].id_,
+                           points_[facet.vertices_[1]].id_,
+                           points_[facet.vertices_[2]].id_);
+      }
+    }
+  }
   for (auto&& face : hull_) {
     Permute(face);
   }
   std::sort(hull_.begin(), hull_.end());
+  are_faces_stale_ = false;
+}
+
+void ConvexHull::BuildKinetic(int number_of_threads) {
+  perturbation_order_.clear();
+  std::sort(points_.begin(), points_.end(),
+            [](const Point& lhs, const Point& rhs) { return lhs.x_ < rhs.x_; });
+  lower_pass_.Reset(number_of_vertices_);
+  upper_pass_.Reset(number_of_vertices_);
+  if (number_of_threads > 1) {
+    std::thread thread([&]() {
+      InitializeDownHull(upper_pass_, number_of_threads / 2);
+    });
+    InitializeDownHull(lower_pass_,
+                       number_of_threads - number_of_threads / 2);
+    thread.join();
+  } else {
+    InitializeDownHull(lower_pass_, 1);
+    InitializeDownHull(upper_pass_, 1);
+  }
+  AddFaces(lower_pass_);
+  AddFaces(upper_pass_);
+}
+
+void ConvexHull::ConflictGraph::AddConflict(int facet, int point) {
+  conflict_facet_[point] = facet;
+  next_conflict_[point] = facets_[facet].first_conflict_;
+  facets_[facet].first_conflict_ = point;
+}
+
+void ConvexHull::ConflictGraph::AddChild(int facet, int child) {
+  children_.emplace_back(child, facets_[facet].first_child_);
+  facets_[facet].first_child_ = children_.size() - 1;
+}
+
+void ConvexHull::BuildIncremental(bool keeps_history) {
+  ConflictGraph& graph = conflict_graph_;
+  graph.Reset(number_of_vertices_);
+  graph.keeps_history_ = keeps_history;
+  // The points are added in the order of points_, so they are shuffled. The
+  // perturbation keeps the order before the shuffle: in the order of the
+  // insertions most points on a plane would stay outside until the end.
+  perturbation_order_.resize(number_of_vertices_);
+  for (int i = 0; i < number_of_vertices_; ++i) {
+    perturbation_order_[i] = i;
+  }
+  std::mt19937 random(RANDOM_SEED_);
+  std::shuffle(perturbation_order_.begin(), perturbation_order_.end(),
+               random);
+  points_.swap(graph.points_);
+  points_.resize(number_of_vertices_);
+  for (int i = 0; i < number_of_vertices_; ++i) {
+    points_[i] = graph.points_[perturbation_order_[i]];
+  }
+
+  // the tetrahedron of the first four points with the faces turning
+  // counterclockwise from outside
+  int a = 0;
+  int b = 1;
+  int c = 2;
+  int d = 3;
+  if (Orientation(a, b, c, d) > 0) {
+    std::swap(b, c);
+  }
+  int faces[4][3] = {{a, b, c}, {a, d, b}, {b, d, c}, {c, d, a}};
+  for (auto&& face : faces) {
+    NewFacet(face[0], face[1], face[2]);
+  }
+  for (int facet = 0; facet < 4; ++facet) {
+    for (int edge = 0; edge < 3; ++edge) {
+      int from = faces[facet][edge];
+      int to = faces[facet][(edge + 1) % 3];
+      for (int other = 0; other < 4; ++other) {
+        for (int other_edge = 0; other_edge < 3; ++other_edge) {
+          if (faces[other][other_edge] == to &&
+              faces[other][(other_edge + 1) % 3] == from) {
+            graph.facets_[facet].neighbors_[edge] = other;
+          }
+        }
+      }
+    }
+  }
+  for (int i = 4; i < number_of_vertices_; ++i) {
+    for (int facet = 0; facet < 4; ++facet) {
+      if (IsVisible(facet, i)) {
+        graph.AddConflict(facet, i);
+        break;
+      }
+    }
+  }
+
+  for (int i = 4; i < number_of_vertices_; ++i) {
+    if (graph.conflict_facet_[i] != NIL_) {
+      InsertPoint(i);
+    }
+  }
+}
+
+int ConvexHull::NewFacet(int first_point, int second_point,
+                         int third_point) {
+  ConflictGraph& graph = conflict_graph_;
+  int facet;
+  if (graph.free_facets_.empty()) {
+    facet = graph.facets_.size();
+    graph.facets_.emplace_back();
+  } else {
+    facet = graph.free_facets_.back();
+    graph.free_facets_.pop_back();
+  }
+  // the normal is exact in 64 bits
+  auto normal = VectorProduct(IntegerVector(first_point, second_point),
+                              IntegerVector(second_point, third_point));
+  graph.facets_[facet] = {
+      {first_point, second_point, third_point},
+      {NIL_, NIL_, NIL_},
+      BasicVector<double>(normal.x_, normal.y_, normal.z_),
+      NIL_,
+      NIL_,
+      NIL_,
+      false,
+      true};
+  return facet;
+}
+
+void ConvexHull::InsertPoint(int point) {
+  ConflictGraph& graph = conflict_graph_;
+  auto& facets = graph.facets_;
+  int insertion = ++graph.insertion_;
+
+  // the faces seen from the point are connected, they are searched from
+  // the one of its conflict and are bordered by the horizon
+  graph.visible_.clear();
+  graph.horizon_.clear();
+  int first_facet = graph.conflict_facet_[point];
+  facets[first_facet].visited_ = insertion;
+  facets[first_facet].is_visible_ = true;
+  graph.visible_.push_back(first_facet);
+  for (size_t i = 0; i < graph.visible_.size(); ++i) {
+    int facet = graph.visible_[i];
+    for (int edge = 0; edge < 3; ++edge) {
+      int neighbor = facets[facet].neighbors_[edge];
+      if (facets[neighbor].visited_ != insertion) {
+        facets[neighbor].visited_ = insertion;
+        facets[neighbor].is_visible_ = IsVisible(neighbor, point);
+        if (facets[neighbor].is_visible_) {
+          graph.visible_.push_back(neighbor);
+        }
+      }
+      if (!facets[neighbor].is_visible_) {
+        graph.horizon_.emplace_back(facet, edge);
+      }
+    }
+  }
+
+  // a new face on every edge of the horizon, glued to the face behind the
+  // edge and to the new faces on the next and the previous edges
+  graph.new_facets_.clear();
+  for (auto&& [facet, edge] : graph.horizon_) {
+    int from = facets[facet].vertices_[edge];
+    int to = facets[facet].vertices_[(edge + 1) % 3];
+    int behind = facets[facet].neighbors_[edge];
+    int new_facet = NewFacet(from, to, point);
+    facets[new_facet].neighbors_[0] = behind;
+    for (auto&& neighbor : facets[behind].neighbors_) {
+      if (neighbor == facet) {
+        neighbor = new_facet;
+      }
+    }
+    graph.facet_by_start_[from] = new_facet;
+    graph.new_facets_.push_back(new_facet);
+    // a point seeing the new face sees one of the faces on its edge
+    if (graph.keeps_history_) {
+      graph.AddChild(facet, new_facet);
+      graph.AddChild(behind, new_facet);
+    }
+  }
+  for (int new_facet : graph.new_facets_) {
+    int next_facet = graph.facet_by_start_[facets[new_facet].vertices_[1]];
+    facets[new_facet].neighbors_[1] = next_facet;
+    facets[next_facet].neighbors_[2] = new_facet;
+  }
+
+  // A point seeing a removed face and outside the new hull sees a new face:
+  // the segment from it to the removed face enters the new hull through the
+  // cone of the added point. Others are inside for good.
+  for (int facet : graph.visible_) {
+    int conflict = facets[facet].first_conflict_;
+    while (conflict != NIL_) {
+      int next_conflict = graph.next_conflict_[conflict];
+      graph.conflict_facet_[conflict] = NIL_;
+      if (conflict != point) {
+        for (int new_facet : graph.new_facets_) {
+          if (IsVisible(new_facet, conflict)) {
+            graph.AddConflict(new_facet, conflict);
+            break;
+          }
+        }
+      }
+      conflict = next_conflict;
+    }
+    facets[facet].is_alive_ = false;
+    if (!graph.keeps_history_) {
+      graph.free_facets_.push_back(facet);
+    }
+  }
+}
+
+int ConvexHull::Locate(int point) {
+  ConflictGraph& graph = conflict_graph_;
+  auto& facets = graph.facets_;
+  // points coming one near the other see the faces of the last insertion,
+  // the history is deep along a sorted order
+  for (int facet : graph.new_facets_) {
+    if (facets[facet].is_alive_ && IsVisible(facet, point)) {
+      return facet;
+    }
+  }
+
+  int insertion = ++graph.insertion_;
+  // the faces of the first tetrahedron are the first ones and the point
+  // outside of the hull sees one of them
+  graph.visible_.clear();
+  for (int facet = 0; facet < 4; ++facet) {
+    facets[facet].visited_ = insertion;
+    if (IsVisible(facet, point)) {
+      graph.visible_.push_back(facet);
+    }
+  }
+  // depth first, a path down to a face of the hull is enough
+  while (!graph.visible_.empty()) {
+    int facet = graph.visible_.back();
+    graph.visible_.pop_back();
+    if (facets[facet].is_alive_) {
+      return facet;
+    }
+    for (int child = facets[facet].first_child_; child != NIL_;
+         child = graph.children_[child].second) {
+      int child_facet = graph.children_[child].first;
+      if (facets[child_facet].visited_ != insertion) {
+        facets[child_facet].visited_ = insertion;
+        if (IsVisible(child_facet, point)) {
+          if (facets[child_facet].is_alive_) {
+            return child_facet;
+          }
+          graph.visible_.push_back(child_facet);
+        }
+      }
+    }
+  }
+  return NIL_;
+}
+
+bool ConvexHull::IsVisible(int facet, int point) const {
+  const auto& current = conflict_graph_.facets_[facet];
+  auto offset = points_[point] - points_[current.vertices_[0]];
+  const auto& normal = current.normal_;
+  double side = normal.x_ * offset.x_ + normal.y_ * offset.y_ +
+                normal.z_ * offset.z_;
+  double magnitude = std::abs(normal.x_ * offset.x_) +
+                     std::abs(normal.y_ * offset.y_) +
+                     std::abs(normal.z_ * offset.z_);
+  if (std::abs(side) > ERROR_BOUND_ * magnitude) {
+    return side > 0;
+  }
+  return Orientation(current.vertices_[0], current.vertices_[1],
+                     current.vertices_[2], point) > 0;
+}
+
+bool ConvexHull::Act(Pass& pass, int vertex) {
+  int prev = pass.prev_[vertex];
+  int next = pass.next_[vertex];
+  if (pass.next_[prev] == vertex) {
+    pass.next_[prev] = next;
+    pass.prev_[next] = prev;
+    return false;
+  }
+  pass.next_[prev] = vertex;
+  pass.prev_[next] = vertex;
+  return true;
 }
 
-void ConvexHull::InitializeDownHull(size_t left_size, size_t right_size) {
-  std::vector<std::shared_ptr<Point>> events = DownHull(left_size, right_size);
+void ConvexHull::InitializeDownHull(Pass& pass, int number_of_threads) {
+  pass.events_[0] = NIL_;
+  if (number_of_vertices_ != 0) {
+    DownHull(pass, 0, number_of_vertices_, pass.events_.data(),
+             pass.buffer_.data(), number_of_threads);
+  }
+}
 
-  for (auto&& event : events) {
-    Face face(event->prev_->id_, event->id_, event->next_->id_);
+void ConvexHull::AddFaces(Pass& pass) {
+  for (int* event = pass.events_.data(); *event != NIL_; ++event) {
+    Face face(points_[pass.prev_[*event]].id_, points_[*event].id_,
+              points_[pass.next_[*event]].id_);
 
-    if (!event->Act() ^ is_down_hull_built) {
+    if (!Act(pass, *event) ^ pass.is_upper_) {
       std::swap(std::get<0>(face), std::get<1>(face));
     }
     hull_.emplace_back(face);
   }
 }
 
-void ConvexHull::FindSupportingRib(std::shared_ptr<Point>& u,
-                                   std::shared_ptr<Point>& v) {
+void ConvexHull::FindSupportingRib(const Pass& pass, int& u, int& v) const {
   while (true) {
-    if (IsClockwise(u, v, v->next_)) {
-      v = v->next_;
-    } else if (IsClockwise(u->prev_, u, v)) {
-      u = u->prev_;
+    if (IsClockwise(u, v, pass.next_[v])) {
+      v = pass.next_[v];
+    } else if (IsClockwise(pass.prev_[u], u, v)) {
+      u = pass.prev_[u];
     } else {
       break;
     }
   }
 }
 
-void ConvexHull::ProcessStates(
-    std::shared_ptr<Point>& u, std::shared_ptr<Point>& v,
-    std::pair<std::vector<std::shared_ptr<Point>>,
-              std::vector<std::shared_ptr<Point>>>& parts_of_hull,
-    std::vector<std::shared_ptr<Point>> part_of_hull) {
-  double time = -INF;
-  size_t first_part = 0;
-  size_t second_part = 0;
+int ConvexHull::ProcessStates(Pass& pass, int& u, int& v,
+                              const int* left_events, const int* right_events,
+                              int* part_of_hull) {
+  EventTime time;
+  time.value_ = -HUGE_VAL;
+  int size = 0;
+  // a time depends only on its triple, so it is kept until the triple changes
+  EventTime next_time[6];
+  auto update = [&](int index, int first_point, int second_point,
+                    int third_point) {
+    const int* points = next_time[index].points_;
+    if (points[0] != first_point || points[1] != second_point ||
+        points[2] != third_point) {
+      next_time[index] = Time(pass, first_point, second_point, third_point);
+    }
+  };
   while (true) {
-    std::shared_ptr<Point> left = nullptr;
-    std::shared_ptr<Point> right = nullptr;
-    std::vector<double> next_time(6, INF);
+    int left = *left_events;
+    int right = *right_events;
 
-    if (first_part < parts_of_hull.first.size()) {
-      left = parts_of_hull.first[first_part];
-      next_time[0] = Time(left->prev_, left, left->next_);
+    if (left != NIL_) {
+      update(0, pass.prev_[left], left, pass.next_[left]);
+    } else {
+      next_time[0] = EventTime();
     }
-    if (second_part < parts_of_hull.second.size()) {
-      right = parts_of_hull.second[second_part];
-      next_time[1] = Time(right->prev_, right, right->next_);
+    if (right != NIL_) {
+      update(1, pass.prev_[right], right, pass.next_[right]);
+    } else {
+      next_time[1] = EventTime();
     }
-    next_time[2] = Time(u->prev_, u, v);
-    next_time[3] = Time(u, u->next_, v);
-    next_time[4] = Time(u, v, v->next_);
-    next_time[5] = Time(u, v->prev_, v);
+    update(2, pass.prev_[u], u, v);
+    update(3, u, pass.next_[u], v);
+    update(4, u, v, pass.next_[v]);
+    update(5, u, pass.prev_[v], v);
 
     int min_time_index = -1;
-    double min_time = INF;
-    for (size_t i = 0; i < 6; ++i) {
-      if (next_time[i] > time && next_time[i] < min_time) {
-        min_time = next_time[i];
+    for (int i = 0; i < 6; ++i) {
+      if (IsEarlier(pass, time, next_time[i]) &&
+          (min_time_index == -1 ||
+           IsEarlier(pass, next_time[i], next_time[min_time_index]))) {
         min_time_index = i;
       }
     }
-    if (min_time_index == -1 || min_time >= INF) {
+    if (min_time_index == -1 || next_time[min_time_index].value_ == HUGE_VAL) {
       break;
     }
 
     switch (min_time_index) {
       case 0:
-        if (left->x_ < u->x_) {
-          part_of_hull.emplace_back(left);
+        if (IsLeftOf(left, u)) {
+          part_of_hull[size++] = left;
         }
-        left->Act();
-        ++first_part;
+        Act(pass, left);
+        ++left_events;
         break;
       case 1:
-        if (right->x_ > v->x_) {
-          part_of_hull.emplace_back(right);
+        if (IsLeftOf(v, right)) {
+          part_of_hull[size++] = right;
         }
-        right->Act();
-        ++second_part;
+        Act(pass, right);
+        ++right_events;
         break;
       case 2:
-        part_of_hull.emplace_back(u);
-        u = u->prev_;
+        part_of_hull[size++] = u;
+        u = pass.prev_[u];
         break;
       case 3:
-        u = u->next_;
-        part_of_hull.emplace_back(u);
+        u = pass.next_[u];
+        part_of_hull[size++] = u;
         break;
       case 4:
-        part_of_hull.emplace_back(v);
-        v = v->next_;
+        part_of_hull[size++] = v;
+        v = pass.next_[v];
         break;
       case 5:
-        v = v->prev_;
-        part_of_hull.emplace_back(v);
+        v = pass.prev_[v];
+        part_of_hull[size++] = v;
         break;
       default:
         break;
     }
-    time = min_time;
+    time = next_time[min_time_index];
   }
+  return size;
 }
 
-std::vector<std::shared_ptr<Point>> ConvexHull::DownHull(size_t left_size,
-                                                         size_t right_size) {
+void ConvexHull::DownHull(Pass& pass, int left_size, int right_size,
+                          int* events, int* buffer, int number_of_threads) {
   if (right_size - left_size == 1) {
-    return std::vector<std::shared_ptr<Point>>();
-  }
-
-  size_t middle = (left_size + right_size) / 2;
-  std::pair<std::vector<std::shared_ptr<Point>>,
-            std::vector<std::shared_ptr<Point>>>
-      parts_of_hull;
-  parts_of_hull.first = DownHull(left_size, middle);
-  parts_of_hull.second = DownHull(middle, right_size);
-
-  std::vector<std::shared_ptr<Point>> part_of_hull;
-  std::shared_ptr<Point> u = std::make_shared<Point>(points_[middle - 1]);
-  std::shared_ptr<Point> v = std::make_shared<Point>(points_[middle]);
-
-  FindSupportingRib(u, v);
-  ProcessStates(u, v, parts_of_hull, part_of_hull);
-
-  u->next_ = v;
-  v->prev_ = u;
-  for (int i = static_cast<int>(part_of_hull.size() - 1); i >= 0; --i) {
-    std::shared_ptr<Point> current = part_of_hull[i];
-    if (current->x_ > u->x_ && current->x_ < v->x_) {
-      u->next_ = current;
-      v->prev_ = current;
-      current->prev_ = u;
-      current->next_ = v;
-      if (current->x_ <= points_[middle - 1].x_) {
+    events[0] = NIL_;
+    return;
+  }
+
+  // the halves write their events to buffer, the merge reads them from there
+  // and writes its own to events, so the roles swap on every level. The
+  // halves touch disjoint parts of the arrays and can be built in parallel.
+  int middle = (left_size + right_size) / 2;
+  int* left_events = buffer;
+  int* right_events = buffer + 2 * (middle - left_size);
+  int* right_buffer = events + 2 * (middle - left_size);
+  if (number_of_threads > 1 && right_size - left_size >= PARALLEL_CUTOFF_) {
+    std::thread thread([&]() {
+      DownHull(pass, left_size, middle, left_events, events,
+               number_of_threads / 2);
+    });
+    DownHull(pass, middle, right_size, right_events, right_buffer,
+             number_of_threads - number_of_threads / 2);
+    thread.join();
+  } else {
+    DownHull(pass, left_size, middle, left_events, events, 1);
+    DownHull(pass, middle, right_size, right_events, right_buffer, 1);
+  }
+
+  int u = middle - 1;
+  int v = middle;
+
+  FindSupportingRib(pass, u, v);
+  int size = ProcessStates(pass, u, v, left_events, right_events, events);
+  events[size] = NIL_;
+
+  // the frame is now at the end of the movie, go back in time to its start
+  pass.next_[u] = v;
+  pass.prev_[v] = u;
+  for (int i = size - 1; i >= 0; --i) {
+    int current = events[i];
+    if (IsLeftOf(u, current) && IsLeftOf(current, v)) {
+      pass.next_[u] = current;
+      pass.prev_[v] = current;
+      pass.prev_[current] = u;
+      pass.next_[current] = v;
+      if (!IsLeftOf(middle - 1, current)) {
         u = current;
       } else {
         v = current;
       }
     } else {
-      current->Act();
+      Act(pass, current);
       if (current == u) {
-        u = u->prev_;
+        u = pass.prev_[u];
       }
       if (current == v) {
-        v = v->next_;
+        v = pass.next_[v];
       }
     }
   }
+}
+
+BasicVector<int64_t> ConvexHull::IntegerVector(int from_point,
+                                              int to_point) const {
+  // the coordinates are integers, so the conversions are exact
+  return BasicVector<int64_t>(
+      static_cast<int64_t>(points_[to_point].x_ - points_[from_point].x_),
+      static_cast<int64_t>(points_[to_point].y_ - points_[from_point].y_),
+      static_cast<int64_t>(points_[to_point].z_ - points_[from_point].z_));
+}
 
-  return part_of_hull;
+bool ConvexHull::IsLeftOf(int first_point, int second_point) const {
+  // the perturbation of x breaks ties in favour of the lesser index
+  return points_[first_point].x_ < points_[second_point].x_ ||
+         (points_[first_point].x_ == points_[second_point].x_ &&
+          first_point < second_point);
 }
 
-bool ConvexHull::IsClockwise(const std::shared_ptr<Point>& first_point,
-                             const std::shared_ptr<Point>& second_point,
-                             const std::shared_ptr<Point>& third_point) {
-  if (first_point == nullptr || second_point == nullptr ||
-      third_point == nullptr) {
+bool ConvexHull::IsClockwise(int first_point, int second_point,
+                             int third_point) const {
+  if (first_point == NIL_ || second_point == NIL_ || third_point == NIL_) {
     return false;
   }
-  return VectorProduct(Vector(*second_point - *first_point),
-                       Vector(*third_point - *second_point))
-             .z_ < 0;
+
+  int64_t turn = VectorProduct(IntegerVector(first_point, second_point),
+                               IntegerVector(second_point, third_point))
+                     .z_;
+  if (turn != 0) {
+    return turn < 0;
+  }
+  int points[3] = {first_point, second_point, third_point};
+  return ExactDenominatorSign(points) < 0;
+}
+
+ConvexHull::EventTime ConvexHull::Time(const Pass& pass, int first_point,
+                                       int second_point,
+                                       int third_point) const {
+  EventTime time;
+  if (first_point == NIL_ || second_point == NIL_ || third_point == NIL_) {
+    return time;
+  }
+
+  auto vector_product =
+      VectorProduct(IntegerVector(first_point, second_point),
+                    IntegerVector(second_point, third_point));
+  time.points_[0] = first_point;
+  time.points_[1] = second_point;
+  time.points_[2] = third_point;
+  // mirroring z changes the sign of the time
+  time.numerator_ = pass.is_upper_ ? vector_product.y_ : -vector_product.y_;
+  time.denominator_ = vector_product.z_;
+  if (time.denominator_ != 0) {
+    time.denominator_sign_ = time.denominator_ < 0 ? -1 : 1;
+    time.value_ = static_cast<double>(time.numerator_) /
+                  static_cast<double>(time.denominator_);
+    time.error_ = ERROR_BOUND_ * std::abs(time.value_);
+  } else {
+    time.value_ = 0;
+    time.error_ = HUGE_VAL;
+    time.denominator_sign_ = ExactDenominatorSign(time.points_);
+  }
+  return time;
+}
+
+bool ConvexHull::IsEarlier(const Pass& pass, const EventTime& first,
+                           const EventTime& second) const {
+  if (std::abs(first.value_ - second.value_) > first.error_ + second.error_) {
+    return first.value_ < second.value_;
+  }
+  // the filter fails on equal infinities, times of missing events
+  if (std::isinf(first.value_) || std::isinf(second.value_)) {
+    return first.value_ < second.value_;
+  }
+  return CompareExactly(pass, first, second) < 0;
+}
+
+int ConvexHull::PerturbationIndex(int point) const {
+  return perturbation_order_.empty() ? point : perturbation_order_[point];
+}
+
+void ConvexHull::ExactVectors(const int* points, const int* involved,
+                              int number_of_involved,
+                              SymbolicNumber* first_vector,
+                              SymbolicNumber* second_vector) const {
+  // the variable of a point in a coordinate is d^exponents[point][coordinate]
+  int64_t exponents[3][3];
+  int64_t coordinates[3][3];
+  for (int i = 0; i < 3; ++i) {
+    auto position =
+        std::lower_bound(involved, involved + number_of_involved,
+                         PerturbationIndex(points[i]));
+    int64_t exponent = 1;
+    for (int j = 0; j < 3 * (position - involved); ++j) {
+      exponent *= 3;
+    }
+    for (int coordinate = 0; coordinate < 3; ++coordinate) {
+      exponents[i][coordinate] = exponent;
+      exponent *= 3;
+    }
+    // the coordinates are integers, so the conversions are exact
+    coordinates[i][0] = static_cast<int64_t>(points_[points[i]].x_);
+    coordinates[i][1] = static_cast<int64_t>(points_[points[i]].y_);
+    coordinates[i][2] = static_cast<int64_t>(points_[points[i]].z_);
+  }
+  // (to - d_to) - (from - d_from) in one coordinate
+  auto difference = [&](int from, int to, int coordinate,
+                        SymbolicNumber& result) {
+    result.size_ = 0;
+    int64_t constant =
+        coordinates[to][coordinate] - coordinates[from][coordinate];
+    if (constant != 0) {
+      result.terms_[result.size_++] = {0, constant};
+    }
+    SymbolicNumber::Term first = {exponents[to][coordinate], -1};
+    SymbolicNumber::Term second = {exponents[from][coordinate], 1};
+    if (first.exponent_ > second.exponent_) {
+      std::swap(first, second);
+    }
+    result.terms_[result.size_++] = first;
+    result.terms_[result.size_++] = second;
+  };
+  for (int coordinate = 0; coordinate < 3; ++coordinate) {
+    difference(0, 1, coordinate, first_vector[coordinate]);
+    difference(1, 2, coordinate, second_vector[coordinate]);
+  }
+}
+
+int ConvexHull::ExactDenominatorSign(const int* points) const {
+  int involved[3] = {PerturbationIndex(points[0]),
+                     PerturbationIndex(points[1]),
+                     PerturbationIndex(points[2])};
+  std::sort(involved, involved + 3);
+  SymbolicNumber first_vector[3];
+  SymbolicNumber second_vector[3];
+  ExactVectors(points, involved, 3, first_vector, second_vector);
+  return SignOfDifference(first_vector[0], second_vector[1], first_vector[1],
+                          second_vector[0]);
+}
+
+int ConvexHull::Orientation(int first_point, int second_point,
+                            int third_point, int fourth_point) const {
+  // the volume is the product of the first edge and the vector product of
+  // the others
+  auto first_vector = points_[second_point] - points_[first_point];
+  auto second_vector = points_[third_point] - points_[second_point];
+  auto third_vector = points_[fourth_point] - points_[third_point];
+  auto minors = VectorProduct(second_vector, third_vector);
+  double volume = first_vector.x_ * minors.x_ + first_vector.y_ * minors.y_ +
+                  first_vector.z_ * minors.z_;
+  // the sum of the magnitudes of the terms bounds the rounding
+  auto magnitudes = [](const BasicVector<double>& vector) {
+    return BasicVector<double>(std::abs(vector.x_), std::abs(vector.y_),
+                               std::abs(vector.z_));
+  };
+  auto first = magnitudes(first_vector);
+  auto second = magnitudes(second_vector);
+  auto third = magnitudes(third_vector);
+  double magnitude = first.x_ * (second.y_ * third.z_ + second.z_ * third.y_) +
+                     first.y_ * (second.z_ * third.x_ + second.x_ * third.z_) +
+                     first.z_ * (second.x_ * third.y_ + second.y_ * third.x_);
+  if (std::abs(volume) > ERROR_BOUND_ * magnitude) {
+    return volume < 0 ? -1 : 1;
+  }
+
+  auto integer_vector = IntegerVector(first_point, second_point);
+  auto integer_minors =
+      VectorProduct(IntegerVector(second_point, third_point),
+                    IntegerVector(third_point, fourth_point));
+  __int128 exact_volume =
+      static_cast<__int128>(integer_vector.x_) * integer_minors.x_ +
+      static_cast<__int128>(integer_vector.y_) * integer_minors.y_ +
+      static_cast<__int128>(integer_vector.z_) * integer_minors.z_;
+  if (exact_volume != 0) {
+    return exact_volume < 0 ? -1 : 1;
+  }
+
+  int points[4] = {first_point, second_point, third_point, fourth_point};
+  int involved[4];
+  for (int i = 0; i < 4; ++i) {
+    involved[i] = PerturbationIndex(points[i]);
+  }
+  std::sort(involved, involved + 4);
+  SymbolicNumber vectors[3][3];
+  SymbolicNumber repeated_vector[3];
+  ExactVectors(points, involved, 4, vectors[0], vectors[1]);
+  ExactVectors(points + 1, involved, 4, repeated_vector, vectors[2]);
+  SymbolicNumber symbolic_minors[3];
+  for (int i = 0; i < 3; ++i) {
+    int j = (i + 1) % 3;
+    int k = (i + 2) % 3;
+    symbolic_minors[i] = vectors[1][j] * vectors[2][k] -
+                         vectors[1][k] * vectors[2][j];
+  }
+  const SymbolicNumber* lhs[3] = {&vectors[0][0], &vectors[0][1],
+                                  &vectors[0][2]};
+  const SymbolicNumber* rhs[3] = {&symbolic_minors[0], &symbolic_minors[1],
+                                  &symbolic_minors[2]};
+  int signs[3] = {1, 1, 1};
+  return SignOfSum(lhs, rhs, signs, 3);
 }
 
-double ConvexHull::Time(const std::shared_ptr<Point>& first_point,
-                        const std::shared_ptr<Point>& second_point,
-                        const std::shared_ptr<Point>& third_point) {
-  if (first_point == nullptr || second_point == nullptr ||
-      third_point == nullptr) {
-    return INF;
+int ConvexHull::CompareExactly(const Pass& pass, const EventTime& first,
+                               const EventTime& second) const {
+  // a time of the same triple is compared with itself often
+  if (std::equal(first.points_, first.points_ + 3, second.points_)) {
+    return 0;
   }
+  if (std::isinf(first.value_) || std::isinf(second.value_)) {
+    return (first.value_ > second.value_) - (first.value_ < second.value_);
+  }
+  if (first.denominator_ != 0 && second.denominator_ != 0) {
+    __int128 difference =
+        static_cast<__int128>(first.numerator_) * second.denominator_ -
+        static_cast<__int128>(second.numerator_) * first.denominator_;
+    if (difference != 0) {
+      return (difference < 0 ? -1 : 1) * first.denominator_sign_ *
+             second.denominator_sign_;
+    }
+  }
+
+  int involved[6];
+  for (int i = 0; i < 3; ++i) {
+    involved[i] = PerturbationIndex(first.points_[i]);
+    involved[i + 3] = PerturbationIndex(second.points_[i]);
+  }
+  std::sort(involved, involved + 6);
+  int number_of_involved = std::unique(involved, involved + 6) - involved;
 
-  Vector vector_product = VectorProduct(Vector(*second_point - *first_point),
-                                        Vector(*third_point - *second_point));
+  // numerators and denominators of the times
+  SymbolicNumber numerators[2];
+  SymbolicNumber denominators[2];
+  const EventTime* times[2] = {&first, &second};
+  for (int i = 0; i < 2; ++i) {
+    SymbolicNumber first_vector[3];
+    SymbolicNumber second_vector[3];
+    ExactVectors(times[i]->points_, involved, number_of_involved,
+                 first_vector, second_vector);
+    numerators[i] = first_vector[0] * second_vector[2] -
+                    first_vector[2] * second_vector[0];
+    denominators[i] = first_vector[0] * second_vector[1] -
+                      first_vector[1] * second_vector[0];
+  }
+  int sign = SignOfDifference(numerators[0], denominators[1], numerators[1],
+                              denominators[0]);
+  // mirroring z changes the sign of the time
+  if (pass.is_upper_) {
+    sign = -sign;
+  }
+  return sign * first.denominator_sign_ * second.denominator_sign_;
+}
 
-  return -vector_product.y_ / vector_product.z_;
+void ConvexHull::Print() const {
+  std::string output;
+  Print(output);
+  std::cout << output;
 }
 
-void ConvexHull::Print() {
-  std::cout << hull_.size() << std::endl;
+void ConvexHull::Print(std::string& output) const {
+  UpdateFaces();
+  auto append = [&output](size_t number) {
+    char digits[20];
+    int size = 0;
+    do {
+      digits[size++] = '0' + number % 10;
+      number /= 10;
+    } while (number != 0);
+    while (size > 0) {
+      output.push_back(digits[--size]);
+    }
+  };
+
+  append(hull_.size());
+  output.push_back('\n');
   for (auto&& face : hull_) {
-    std::cout << "3 " << std::get<0>(face) << " " << std::get<1>(face) << " "
-              << std::get<2>(face) << std::endl;
+    output += "3 ";
+    append(std::get<0>(face));
+    output.push_back(' ');
+    append(std::get<1>(face));
+    output.push_back(' ');
+    append(std::get<2>(face));
+    output.push_back('\n');
   }
 }
 
-int main() {
-  size_t number_of_tests = 0;
-  std::cin >> number_of_tests;
+// Reads whitespace separated integers from a file through a big buffer.
+class InputReader {
+ public:
+  explicit InputReader(FILE* file) : file_(file) {}
+
+  // returns 0 at the end of the file
+  int64_t ReadInteger();
+
+ private:
+  constexpr static const int BUFFER_SIZE_ = 1 << 16;
+
+  // the next character or EOF
+  int Peek();
 
-  for (size_t i = 0; i < number_of_tests; ++i) {
-    const double SHIFT_ANGLE = 0.01;
-    size_t number_of_vertices = 0;
-    std::cin >> number_of_vertices;
-    std::vector<Point> points(number_of_vertices, Point());
-    int id = 0;
-    for (auto&& point : points) {
-      std::cin >> point.x_ >> point.y_ >> point.z_;
-      point.id_ = id;
-      ++id;
-      RotateAroundThirdDimension(point.x_, point.y_, SHIFT_ANGLE);
-      RotateAroundThirdDimension(point.z_, point.x_, SHIFT_ANGLE);
-      RotateAroundThirdDimension(point.y_, point.z_, SHIFT_ANGLE);
+  FILE* file_;
+  char buffer_[BUFFER_SIZE_];
+  int position_ = 0;
+  int size_ = 0;
+};
+
+int InputReader::Peek() {
+  if (position_ == size_) {
+    size_ = fread(buffer_, 1, BUFFER_SIZE_, file_);
+    position_ = 0;
+    if (size_ == 0) {
+      return EOF;
     }
+  }
+  return static_cast<unsigned char>(buffer_[position_]);
+}
+
+int64_t InputReader::ReadInteger() {
+  int character = Peek();
+  while (character != EOF && character != '-' &&
+         (character < '0' || character > '9')) {
+    ++position_;
+    character = Peek();
+  }
+  bool is_negative = character == '-';
+  if (is_negative) {
+    ++position_;
+    character = Peek();
+  }
+  int64_t value = 0;
+  while (character >= '0' && character <= '9') {
+    value = 10 * value + (character - '0');
+    ++position_;
+    character = Peek();
+  }
+  return is_negative ? -value : value;
+}
+
+// Collects output in a big buffer and writes it to a file when it is full
+// and on destruction.
+class OutputWriter {
+ public:
+  explicit OutputWriter(FILE* file) : file_(file) {}
+  OutputWriter(const OutputWriter&) = delete;
+  OutputWriter& operator=(const OutputWriter&) = delete;
+  ~OutputWriter() { Flush(); }
+
+  void Write(const std::string& text);
+  void Flush();
+
+ private:
+  constexpr static const size_t BUFFER_SIZE_ = 1 << 16;
+
+  FILE* file_;
+  std::string buffer_;
+};
 
-    std::sort(points.begin(), points.end(),
-              [](auto lhs, auto rhs) { return lhs.x_ < rhs.x_; });
+void OutputWriter::Write(const std::string& text) {
+  buffer_ += text;
+  if (buffer_.size() >= BUFFER_SIZE_) {
+    Flush();
+  }
+}
+
+void OutputWriter::Flush() {
+  fwrite(buffer_.data(), 1, buffer_.size(), file_);
+  buffer_.clear();
+}
+
+// Reads the number of tests and the tests, writes their hulls in the same
+// order. With one thread every test is written before the next one is read.
+// With more the tests are read in chunks of about CHUNK_BYTES of points and
+// the tests of a chunk are shared between the threads, each builds hulls in
+// its own workspace. The points and the outputs of a chunk keep their memory
+// for the next ones.
+void SolveTests(InputReader& input, OutputWriter& output,
+                int number_of_threads = 1) {
+  const size_t CHUNK_BYTES = 1 << 22;
+  size_t number_of_tests = input.ReadInteger();
+  number_of_threads = std::max(number_of_threads, 1);
+
+  std::vector<ConvexHull> workspaces(number_of_threads);
+  std::vector<std::vector<Point>> points;
+  std::vector<std::string> outputs;
+  for (size_t begin = 0; begin < number_of_tests;) {
+    size_t size = 0;
+    size_t bytes = 0;
+    while (begin + size < number_of_tests &&
+           (size == 0 || (number_of_threads > 1 && bytes < CHUNK_BYTES))) {
+      if (size == points.size()) {
+        points.emplace_back();
+        outputs.emplace_back();
+      }
+      points[size].resize(input.ReadInteger());
+      int id = 0;
+      for (auto&& point : points[size]) {
+        point.x_ = input.ReadInteger();
+        point.y_ = input.ReadInteger();
+        point.z_ = input.ReadInteger();
+        point.id_ = id;
+        ++id;
+      }
+      bytes += points[size].size() * sizeof(Point);
+      ++size;
+    }
+    begin += size;
 
-    ConvexHull convex_hull(points);
+    // tests are taken one by one, so big ones do not stall a thread
+    std::atomic<size_t> next_test(0);
+    auto solve = [&](ConvexHull& workspace) {
+      for (size_t i = next_test++; i < size; i = next_test++) {
+        workspace.Rebuild(points[i]);
+        outputs[i].clear();
+        workspace.Print(outputs[i]);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < number_of_threads && static_cast<size_t>(i) < size;
+         ++i) {
+      threads.emplace_back(solve, std::ref(workspaces[i]));
+    }
+    solve(workspaces[0]);
+    for (auto&& thread : threads) {
+      thread.join();
+    }
 
-    convex_hull.Print();
+    for (size_t i = 0; i < size; ++i) {
+      output.Write(outputs[i]);
+    }
   }
+}
+
+int main() {
+  InputReader input(stdin);
+  OutputWriter output(stdout);
+  SolveTests(input, output);
 
   return 0;
 }
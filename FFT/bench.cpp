@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "fft.h"
+
+// The transforms of fft.h on random values of sizes 2^MIN_LOG_SIZE_ to
+// 2^max_log_size, every second power, in ns / (n log2 n): the complex one,
+// its inverse, the real one of n values and the number theoretic one (up to
+// its 2^23). Each is the fastest of the runs done on about 2^24 values in
+// total, at least REPETITIONS_. The complex transforms take
+// number_of_threads, above one they go through the six steps from 2^17.
+// The last column is the greatest error of a complex round trip.
+//
+// g++ -std=c++17 -O2 -pthread [-mavx2 -mfma] bench.cpp -o bench &&
+//     ./bench [max_log_size] [number_of_threads]
+//     or ./bench check [max_log_size] [number_of_threads]
+class TransformBenchmark {
+ public:
+  TransformBenchmark(int max_log_size, int number_of_threads)
+      : max_log_size_(max_log_size), number_of_threads_(number_of_threads) {}
+
+  void operator()() {
+    printf("%5s %9s %9s %9s %9s %11s\n", "log n", "complex", "inverse",
+           "real", "ntt", "round trip");
+    std::mt19937_64 generator(9);
+    std::uniform_real_distribution<double> coordinate(-1, 1);
+    FourierTransform transform;
+    NumberTheoreticTransform number_theoretic_transform;
+    for (int log_size = MIN_LOG_SIZE_; log_size <= max_log_size_;
+         log_size += 2) {
+      size_t size = size_t(1) << log_size;
+      int runs = std::max<size_t>(REPETITIONS_, (size_t(1) << 24) / size);
+      double scale = 1e9 / (double(size) * log_size);
+
+      std::vector<Complex> values(size);
+      for (auto&& value : values) {
+        value = Complex(coordinate(generator), coordinate(generator));
+      }
+      std::vector<Complex> transformed = values;
+      double complex_time = BestTime(runs, [&]() {
+        transformed = values;
+        transform.Transform(transformed, number_of_threads_);
+      });
+      std::vector<Complex> restored = transformed;
+      double inverse_time = BestTime(runs, [&]() {
+        restored = transformed;
+        transform.InverseTransform(restored, number_of_threads_);
+      });
+      double error = 0;
+      for (size_t i = 0; i < size; ++i) {
+        error = std::max(error, std::abs(restored[i] - values[i]));
+      }
+
+      std::vector<double> real_values(size);
+      for (auto&& value : real_values) {
+        value = coordinate(generator);
+      }
+      std::vector<Complex> spectrum;
+      double real_time = BestTime(runs, [&]() {
+        transform.RealTransform(real_values, spectrum, number_of_threads_);
+      });
+
+      printf("%5d %9.2f %9.2f %9.2f ", log_size, scale * complex_time,
+             scale * inverse_time, scale * real_time);
+      if (log_size <= NumberTheoreticTransform::MAX_LOG_SIZE_) {
+        std::vector<uint32_t> residues(size);
+        for (auto&& residue : residues) {
+          residue = generator() % NumberTheoreticTransform::MODULUS_;
+        }
+        std::vector<uint32_t> transformed_residues;
+        double ntt_time = BestTime(runs, [&]() {
+          transformed_residues = residues;
+          number_theoretic_transform.Transform(transformed_residues);
+        });
+        printf("%9.2f", scale * ntt_time);
+      } else {
+        printf("%9s", "-");
+      }
+      printf(" %11.2g\n", error);
+    }
+  }
+
+ private:
+  constexpr static const int MIN_LOG_SIZE_ = 10;
+  constexpr static const int REPETITIONS_ = 3;
+
+  // the fastest of runs, in seconds, copies of the input included
+  template <class Function>
+  static double BestTime(int runs, Function function) {
+    double result = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < runs; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      function();
+      result = std::min(result, std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count());
+    }
+    return result;
+  }
+
+  int max_log_size_;
+  int number_of_threads_;
+};
+
+// The transforms of fft.h against references, failing on the first error
+// above TOLERANCE_ relative to the greatest exact value:
+// - Transform and InverseTransform against a port of FFT and FFTReverse of
+//   the notebook, on its sampled functions and on random values;
+// - all four complex ones against a long double DFT up to 2^MAX_LOG_NAIVE_
+//   values, and the NTT exactly against a modular DFT;
+// - greater sizes up to 2^max_log_size with number_of_threads, so through
+//   the six steps from 2^17 with threads: SPOTS_ coefficients against long
+//   double sums, the same transform in one thread and the round trips, the
+//   NTT exactly up to its 2^23.
+class CorrectnessCheck {
+ public:
+  CorrectnessCheck(int max_log_size, int number_of_threads)
+      : max_log_size_(max_log_size), number_of_threads_(number_of_threads) {}
+
+  bool operator()() {
+    return CheckAgainstNotebook() && CheckAgainstDft() && CheckLargeSizes() &&
+           CheckNumberTheoretic();
+  }
+
+ private:
+  using LongComplex = std::complex<long double>;
+
+  constexpr static const double TOLERANCE_ = 1e-12;
+  constexpr static const int MAX_LOG_NAIVE_ = 11;
+  constexpr static const int MIN_LOG_LARGE_ = 12;
+  constexpr static const int SPOTS_ = 16;
+
+  bool CheckAgainstNotebook() {
+    std::function<double(double)> functions[] = {
+        [](double x) { return x; },
+        [](double x) { return x * x; },
+        [](double x) { return std::sin(x); },
+        [](double x) { return std::sin(x * x); },
+        [](double x) { return x == 0 ? 1.0 : std::sin(x) / x; }};
+    std::vector<std::vector<Complex>> inputs;
+    for (auto&& function : functions) {
+      for (double period : {10.0, 50.0}) {
+        std::vector<Complex> samples(128);
+        for (size_t i = 0; i < samples.size(); ++i) {
+          samples[i] = function(period * i / samples.size());
+        }
+        inputs.push_back(samples);
+      }
+    }
+    for (int log_size = 0; log_size <= 12; ++log_size) {
+      inputs.push_back(RandomValues(size_t(1) << log_size));
+    }
+
+    double error = 0;
+    for (auto&& input : inputs) {
+      std::vector<Complex> expected = NotebookFft(input);
+      std::vector<Complex> values = input;
+      transform_.Transform(values);
+      error = std::max(error, Error(values, Widen(expected)));
+      expected = NotebookFftReverse(expected);
+      transform_.InverseTransform(values);
+      error = std::max(error, Error(values, Widen(expected)));
+    }
+    return Report("against the notebook FFT and FFTReverse", error);
+  }
+
+  bool CheckAgainstDft() {
+    double errors[4] = {0, 0, 0, 0};
+    for (int log_size = 0; log_size <= MAX_LOG_NAIVE_; ++log_size) {
+      size_t size = size_t(1) << log_size;
+      std::vector<Complex> input = RandomValues(size);
+      std::vector<Complex> values = input;
+      transform_.Transform(values);
+      errors[0] = std::max(errors[0], Error(values, Dft(Widen(input), -1)));
+      values = input;
+      transform_.InverseTransform(values);
+      std::vector<LongComplex> expected = Dft(Widen(input), 1);
+      for (auto&& value : expected) {
+        value /= static_cast<long double>(size);
+      }
+      errors[1] = std::max(errors[1], Error(values, expected));
+
+      std::vector<double> real_values(size);
+      std::vector<LongComplex> real_input(size);
+      for (size_t i = 0; i < size; ++i) {
+        real_values[i] = input[i].real();
+        real_input[i] = input[i].real();
+      }
+      std::vector<Complex> spectrum;
+      transform_.RealTransform(real_values, spectrum);
+      expected = Dft(real_input, -1);
+      expected.resize(size / 2 + 1);
+      errors[2] = std::max(errors[2], Error(spectrum, expected));
+      std::vector<double> restored;
+      transform_.InverseRealTransform(spectrum, size, restored);
+      errors[3] = std::max(errors[3], Error(restored, real_input));
+    }
+    return Report("Transform against a long double DFT", errors[0]) &&
+           Report("InverseTransform against a long double DFT", errors[1]) &&
+           Report("RealTransform against a long double DFT", errors[2]) &&
+           Report("InverseRealTransform round trips", errors[3]);
+  }
+
+  bool CheckLargeSizes() {
+    double errors[4] = {0, 0, 0, 0};
+    for (int log_size = MIN_LOG_LARGE_; log_size <= max_log_size_;
+         ++log_size) {
+      size_t size = size_t(1) << log_size;
+      std::vector<Complex> input = RandomValues(size);
+      std::vector<Complex> values = input;
+      transform_.Transform(values, number_of_threads_);
+      std::vector<LongComplex> wide_input = Widen(input);
+      std::vector<Complex> spots(SPOTS_);
+      std::vector<LongComplex> expected(SPOTS_);
+      for (int i = 0; i < SPOTS_; ++i) {
+        size_t index = generator_() % size;
+        spots[i] = values[index];
+        expected[i] = Coefficient(wide_input, index);
+      }
+      errors[0] = std::max(errors[0], Error(spots, expected));
+      std::vector<Complex> single_thread_values = input;
+      transform_.Transform(single_thread_values);
+      errors[1] =
+          std::max(errors[1], Error(values, Widen(single_thread_values)));
+      transform_.InverseTransform(values, number_of_threads_);
+      errors[2] = std::max(errors[2], Error(values, wide_input));
+
+      std::vector<double> real_values(size);
+      for (size_t i = 0; i < size; ++i) {
+        real_values[i] = input[i].real();
+      }
+      std::vector<Complex> spectrum;
+      transform_.RealTransform(real_values, spectrum, number_of_threads_);
+      std::vector<double> restored;
+      transform_.InverseRealTransform(spectrum, size, restored,
+                                      number_of_threads_);
+      std::vector<LongComplex> real_input(real_values.begin(),
+                                          real_values.end());
+      errors[3] = std::max(errors[3], Error(restored, real_input));
+    }
+    printf("sizes 2^%d..2^%d in %d threads:\n", MIN_LOG_LARGE_, max_log_size_,
+           number_of_threads_);
+    return Report("Transform at random coefficients", errors[0]) &&
+           Report("Transform against one thread", errors[1]) &&
+           Report("complex round trips", errors[2]) &&
+           Report("real round trips", errors[3]);
+  }
+
+  bool CheckNumberTheoretic() {
+    const uint64_t MODULUS = NumberTheoreticTransform::MODULUS_;
+    NumberTheoreticTransform transform;
+    int max_log_size =
+        std::min(max_log_size_, NumberTheoreticTransform::MAX_LOG_SIZE_);
+    for (int log_size = 0; log_size <= max_log_size; ++log_size) {
+      size_t size = size_t(1) << log_size;
+      std::vector<uint32_t> input(size);
+      for (auto&& value : input) {
+        value = generator_() % MODULUS;
+      }
+      std::vector<uint32_t> values = input;
+      transform.Transform(values);
+
+      // all coefficients of the small sizes, SPOTS_ of the others
+      uint64_t root = NumberTheoreticTransform::Power(
+          NumberTheoreticTransform::PRIMITIVE_ROOT_, (MODULUS - 1) / size);
+      size_t number_of_spots =
+          log_size <= MAX_LOG_NAIVE_ ? size : static_cast<size_t>(SPOTS_);
+      for (size_t i = 0; i < number_of_spots; ++i) {
+        size_t index = log_size <= MAX_LOG_NAIVE_ ? i : generator_() % size;
+        uint64_t step = NumberTheoreticTransform::Power(root, index);
+        uint64_t power = 1;
+        uint64_t expected = 0;
+        for (size_t j = 0; j < size; ++j) {
+          expected = (expected + input[j] * power) % MODULUS;
+          power = power * step % MODULUS;
+        }
+        if (values[index] != expected) {
+          printf("NTT of size %zu: coefficient %zu is %u, not %llu\n", size,
+                 index, values[index],
+                 static_cast<unsigned long long>(expected));
+          return false;
+        }
+      }
+      transform.InverseTransform(values);
+      if (values != input) {
+        printf("NTT of size %zu: the round trip differs\n", size);
+        return false;
+      }
+    }
+    printf("%-45s exact up to 2^%d\n", "NTT against a modular DFT",
+           max_log_size);
+    return true;
+  }
+
+  std::vector<Complex> RandomValues(size_t size) {
+    std::uniform_real_distribution<double> coordinate(-1, 1);
+    std::vector<Complex> values(size);
+    for (auto&& value : values) {
+      value = Complex(coordinate(generator_), coordinate(generator_));
+    }
+    return values;
+  }
+
+  // FFT of the notebook: the halves of the even and the odd values joined
+  // with the roots multiplied one by one
+  static std::vector<Complex> NotebookFft(const std::vector<Complex>& values) {
+    size_t size = values.size();
+    if (size == 1) {
+      return values;
+    }
+    std::vector<Complex> halves[2];
+    for (size_t i = 0; i < size; ++i) {
+      halves[i % 2].push_back(values[i]);
+    }
+    std::vector<Complex> even = NotebookFft(halves[0]);
+    std::vector<Complex> odd = NotebookFft(halves[1]);
+    const double PI = std::acos(-1.0);
+    std::vector<Complex> result(size);
+    Complex coefficient(1, 0);
+    Complex step(std::cos(2 * PI / size), -std::sin(2 * PI / size));
+    for (size_t k = 0; k < size / 2; ++k) {
+      result[k] = even[k] + odd[k] * coefficient;
+      result[k + size / 2] = even[k] - odd[k] * coefficient;
+      coefficient = step * coefficient;
+    }
+    return result;
+  }
+
+  // FFTReverse of the notebook: the transform of the conjugates, conjugated
+  // and divided by the size
+  static std::vector<Complex> NotebookFftReverse(
+      const std::vector<Complex>& values) {
+    std::vector<Complex> result(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      result[i] = std::conj(values[i]);
+    }
+    result = NotebookFft(result);
+    for (auto&& value : result) {
+      value = std::conj(value) / static_cast<double>(values.size());
+    }
+    return result;
+  }
+
+  // the sum of values_j e^(sign 2 pi i j index / n)
+  static LongComplex Coefficient(const std::vector<LongComplex>& values,
+                                 size_t index, int sign = -1) {
+    const long double PI = std::acos(-1.0L);
+    size_t size = values.size();
+    LongComplex result = 0;
+    for (size_t j = 0; j < size; ++j) {
+      long double angle = sign * 2 * PI * (j * index % size) / size;
+      result += values[j] * LongComplex(std::cos(angle), std::sin(angle));
+    }
+    return result;
+  }
+
+  static std::vector<LongComplex> Dft(const std::vector<LongComplex>& values,
+                                      int sign) {
+    std::vector<LongComplex> result(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      result[i] = Coefficient(values, i, sign);
+    }
+    return result;
+  }
+
+  template <class Value>
+  static std::vector<LongComplex> Widen(const std::vector<Value>& values) {
+    return std::vector<LongComplex>(values.begin(), values.end());
+  }
+
+  // the greatest difference relative to the greatest exact value
+  template <class Value>
+  static double Error(const std::vector<Value>& values,
+                      const std::vector<LongComplex>& exact) {
+    long double difference = 0;
+    long double magnitude = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+      difference = std::max(
+          difference, std::abs(LongComplex(values[i]) - exact[i]));
+      magnitude = std::max(magnitude, std::abs(exact[i]));
+    }
+    return static_cast<double>(difference / std::max(magnitude, 1e-300L));
+  }
+
+  static bool Report(const char* name, double error) {
+    bool is_correct = error <= TOLERANCE_;
+    printf("%-45s max error %.2g%s\n", name, error,
+           is_correct ? "" : " -- FAILED");
+    return is_correct;
+  }
+
+  int max_log_size_;
+  int number_of_threads_;
+  FourierTransform transform_;
+  std::mt19937_64 generator_{10};
+};
+
+int main(int argc, char** argv) {
+  bool is_check = argc > 1 && strcmp(argv[1], "check") == 0;
+  int first_argument = is_check ? 2 : 1;
+  int max_log_size =
+      argc > first_argument ? atoi(argv[first_argument]) : is_check ? 20 : 22;
+  int number_of_threads =
+      argc > first_argument + 1 ? atoi(argv[first_argument + 1]) : 1;
+
+  if (is_check) {
+    CorrectnessCheck check(max_log_size, number_of_threads);
+    return check() ? 0 : 1;
+  }
+  TransformBenchmark benchmark(max_log_size, number_of_threads);
+  benchmark();
+
+  return 0;
+}
@@ -0,0 +1,536 @@
+#ifndef FFT_FFT_H_
+#define FFT_FFT_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+using Complex = std::complex<double>;
+
+// without the checks for infinities of operator*, which are not inlined
+inline Complex Multiply(const Complex& lhs, const Complex& rhs) {
+  return Complex(lhs.real() * rhs.real() - lhs.imag() * rhs.imag(),
+                 lhs.real() * rhs.imag() + lhs.imag() * rhs.real());
+}
+
+// value * (-i)
+inline Complex RotateClockwise(const Complex& value) {
+  return Complex(value.imag(), -value.real());
+}
+
+// table[i] is i with log_size bits reversed, the table of a smaller size
+// 2^k is this one shifted right by log_size - k
+inline void FillBitReversal(std::vector<uint32_t>& table, int log_size) {
+  table.assign(size_t(1) << log_size, 0);
+  for (size_t i = 1; i < table.size(); ++i) {
+    table[i] = (table[i >> 1] >> 1) | ((i & 1) << (log_size - 1));
+  }
+}
+
+template <class Value>
+void PermuteBitReversed(Value* values, size_t size,
+                        const std::vector<uint32_t>& bit_reversal,
+                        int shift) {
+  for (size_t i = 0; i < size; ++i) {
+    size_t j = bit_reversal[i] >> shift;
+    if (i < j) {
+      std::swap(values[i], values[j]);
+    }
+  }
+}
+
+inline int Log2(size_t size) {
+  int log_size = 0;
+  while ((size_t(1) << log_size) < size) {
+    ++log_size;
+  }
+  return log_size;
+}
+
+// Runs function(begin, end) on parts of [0, size) in number_of_threads
+// threads, the calling one included.
+template <class Function>
+void RunInParallel(size_t size, int number_of_threads,
+                   const Function& function) {
+  size_t parts = std::min<size_t>(std::max(number_of_threads, 1), size);
+  parts = std::max<size_t>(parts, 1);
+  std::vector<std::thread> threads;
+  for (size_t part = 1; part < parts; ++part) {
+    threads.emplace_back(function, size * part / parts,
+                         size * (part + 1) / parts);
+  }
+  function(0, size / parts);
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+// Two complex numbers in a register, (real, imaginary, real, imaginary).
+inline __m256d LoadPair(const Complex* values) {
+  return _mm256_loadu_pd(reinterpret_cast<const double*>(values));
+}
+
+inline void StorePair(Complex* values, __m256d pair) {
+  _mm256_storeu_pd(reinterpret_cast<double*>(values), pair);
+}
+
+inline __m256d MultiplyPairs(__m256d lhs, __m256d rhs) {
+  __m256d real = _mm256_movedup_pd(rhs);
+  __m256d imaginary = _mm256_permute_pd(rhs, 0xF);
+  __m256d swapped = _mm256_permute_pd(lhs, 0x5);
+  return _mm256_fmaddsub_pd(lhs, real, _mm256_mul_pd(swapped, imaginary));
+}
+
+inline __m256d RotatePairClockwise(__m256d pair) {
+  return _mm256_xor_pd(_mm256_permute_pd(pair, 0x5),
+                       _mm256_set_pd(-0.0, 0.0, -0.0, 0.0));
+}
+
+#endif
+
+// Discrete Fourier transform of sizes that are powers of two, the same as
+// FFT of the notebook: a_k = sum_j x_j e^(-2 pi i jk / n).
+// Sizes that fit the cache are transformed iteratively in place: the values
+// are put in the bit-reversed order and joined by radix-4 butterflies, with
+// one radix-2 pass first for odd powers. With -mavx2 -mfma the butterflies
+// take two numbers at once. Greater sizes are cut into rows and columns of
+// about the square root of the size, which do fit it (six steps).
+// The roots and the bit reversal are tabulated once for the greatest size
+// seen, smaller sizes take every 2^k-th entry.
+class FourierTransform {
+ public:
+  explicit FourierTransform(size_t max_size = 1);
+
+  // the tables for sizes up to max_size, transforms grow them as needed
+  void Reserve(size_t max_size);
+
+  // the threads share the rows and the columns of the six steps
+  void Transform(std::vector<Complex>& values, int number_of_threads = 1);
+  // with the division by the size, as FFTReverse of the notebook
+  void InverseTransform(std::vector<Complex>& values,
+                        int number_of_threads = 1);
+  // The first n / 2 + 1 coefficients of the transform of n real values,
+  // the others are conjugate to them. The values are paired into
+  // x_2j + i x_2j+1 and transformed at half the size.
+  void RealTransform(const std::vector<double>& values,
+                     std::vector<Complex>& spectrum,
+                     int number_of_threads = 1);
+  // size real values with the spectrum from RealTransform
+  void InverseRealTransform(const std::vector<Complex>& spectrum,
+                            size_t size, std::vector<double>& values,
+                            int number_of_threads = 1);
+
+ private:
+  // The iterative passes are streamed from the last level cache as long as
+  // the values fit it, the six steps are faster only beyond. With threads
+  // they are taken once the values leave the second level one, as only
+  // their rows and columns are shared.
+  constexpr static const int MIN_LOG_SIZE_IN_SIX_STEPS_ = 24;
+  constexpr static const int MIN_LOG_SIZE_IN_PARALLEL_SIX_STEPS_ = 17;
+  // columns or rows moved at once, whole cache lines of the other ones
+  constexpr static const size_t PANEL_WIDTH_ = 16;
+
+  void TransformInPlace(Complex* values, size_t size, int number_of_threads);
+  void TransformIteratively(Complex* values, size_t size) const;
+  // The values as a matrix of rows by columns, the index is
+  // row * columns + column. The transforms of the columns, multiplied by
+  // w^(row * column) with w the root of the size, then the transforms of the
+  // rows give the coefficients in the transposed order.
+  void TransformInSixSteps(Complex* values, size_t size,
+                           int number_of_threads);
+  // the transform with the inverse roots is the transform with the indices
+  // negated modulo the size
+  void InverseTransformInPlace(Complex* values, size_t size,
+                               int number_of_threads);
+  // e^(-2 pi i power / size) for a power below the size
+  Complex Root(size_t power, int log_size) const;
+
+  // roots_[length + j] = e^(-pi i j / length), the roots of the butterflies
+  // joining halves of the length
+  std::vector<Complex> roots_;
+  std::vector<uint32_t> bit_reversal_;
+  int log_max_size_ = 0;
+  // the columns transformed by the six steps
+  std::vector<Complex> buffer_;
+};
+
+inline FourierTransform::FourierTransform(size_t max_size) {
+  Reserve(max_size);
+}
+
+inline void FourierTransform::Reserve(size_t max_size) {
+  int log_max_size = Log2(max_size);
+  if (!roots_.empty() && log_max_size <= log_max_size_) {
+    return;
+  }
+  log_max_size_ = log_max_size;
+  FillBitReversal(bit_reversal_, log_max_size_);
+  size_t size = size_t(1) << log_max_size_;
+  roots_.assign(std::max(size, size_t(2)), Complex(1, 0));
+  // the greatest roots from the sine, the others are among them
+  const double PI = std::acos(-1.0);
+  for (size_t j = 0; j < size / 2; ++j) {
+    roots_[size / 2 + j] = std::polar(1.0, -PI * j / (size / 2));
+  }
+  for (size_t length = size / 4; length > 0; length /= 2) {
+    for (size_t j = 0; j < length; ++j) {
+      roots_[length + j] = roots_[2 * (length + j)];
+    }
+  }
+}
+
+inline Complex FourierTransform::Root(size_t power, int log_size) const {
+  size_t half = size_t(1) << (log_max_size_ - 1);
+  size_t index = power << (log_max_size_ - log_size);
+  return index < half ? roots_[half + index] : -roots_[index];
+}
+
+inline void FourierTransform::Transform(std::vector<Complex>& values,
+                                        int number_of_threads) {
+  Reserve(values.size());
+  TransformInPlace(values.data(), values.size(), number_of_threads);
+}
+
+inline void FourierTransform::InverseTransform(std::vector<Complex>& values,
+                                               int number_of_threads) {
+  Reserve(values.size());
+  InverseTransformInPlace(values.data(), values.size(), number_of_threads);
+}
+
+inline void FourierTransform::TransformInPlace(Complex* values, size_t size,
+                                               int number_of_threads) {
+  int log_size = Log2(size);
+  if (log_size >= MIN_LOG_SIZE_IN_SIX_STEPS_ ||
+      (number_of_threads > 1 &&
+       log_size >= MIN_LOG_SIZE_IN_PARALLEL_SIX_STEPS_)) {
+    TransformInSixSteps(values, size, number_of_threads);
+  } else {
+    TransformIteratively(values, size);
+  }
+}
+
+inline void FourierTransform::TransformIteratively(Complex* values,
+                                                   size_t size) const {
+  int log_size = Log2(size);
+  PermuteBitReversed(values, size, bit_reversal_, log_max_size_ - log_size);
+  size_t length = 1;
+  if (log_size % 2 == 1) {
+    for (size_t i = 0; i < size; i += 2) {
+      Complex first = values[i];
+      values[i] = first + values[i + 1];
+      values[i + 1] = first - values[i + 1];
+    }
+    length = 2;
+  }
+  // Two radix-2 passes at once. With w = e^(-pi i j / (2 length)) the
+  // quarters are multiplied by 1, w^2, w and w^3: the first pass joins
+  // them with w^2, the second one with w and w * (-i).
+  for (; 4 * length <= size; length *= 4) {
+    for (size_t start = 0; start < size; start += 4 * length) {
+      Complex* quarter = values + start;
+      size_t j = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+      for (; j + 2 <= length; j += 2) {
+        __m256d root = LoadPair(&roots_[2 * length + j]);
+        __m256d square_root = LoadPair(&roots_[length + j]);
+        __m256d cube_root = MultiplyPairs(root, square_root);
+        __m256d first = LoadPair(quarter + j);
+        __m256d second =
+            MultiplyPairs(square_root, LoadPair(quarter + j + length));
+        __m256d third = MultiplyPairs(root, LoadPair(quarter + j + 2 * length));
+        __m256d fourth =
+            MultiplyPairs(cube_root, LoadPair(quarter + j + 3 * length));
+        __m256d even_sum = _mm256_add_pd(first, second);
+        __m256d even_difference = _mm256_sub_pd(first, second);
+        __m256d odd_sum = _mm256_add_pd(third, fourth);
+        __m256d odd_difference =
+            RotatePairClockwise(_mm256_sub_pd(third, fourth));
+        StorePair(quarter + j, _mm256_add_pd(even_sum, odd_sum));
+        StorePair(quarter + j + length,
+                  _mm256_add_pd(even_difference, odd_difference));
+        StorePair(quarter + j + 2 * length, _mm256_sub_pd(even_sum, odd_sum));
+        StorePair(quarter + j + 3 * length,
+                  _mm256_sub_pd(even_difference, odd_difference));
+      }
+#endif
+      for (; j < length; ++j) {
+        Complex root = roots_[2 * length + j];
+        Complex square_root = roots_[length + j];
+        Complex cube_root = Multiply(root, square_root);
+        Complex first = quarter[j];
+        Complex second = Multiply(square_root, quarter[j + length]);
+        Complex third = Multiply(root, quarter[j + 2 * length]);
+        Complex fourth = Multiply(cube_root, quarter[j + 3 * length]);
+        Complex even_sum = first + second;
+        Complex even_difference = first - second;
+        Complex odd_sum = third + fourth;
+        Complex odd_difference = RotateClockwise(third - fourth);
+        quarter[j] = even_sum + odd_sum;
+        quarter[j + length] = even_difference + odd_difference;
+        quarter[j + 2 * length] = even_sum - odd_sum;
+        quarter[j + 3 * length] = even_difference - odd_difference;
+      }
+    }
+  }
+}
+
+inline void FourierTransform::TransformInSixSteps(Complex* values,
+                                                  size_t size,
+                                                  int number_of_threads) {
+  int log_size = Log2(size);
+  int log_columns = log_size - log_size / 2;
+  size_t rows = size_t(1) << (log_size / 2);
+  size_t columns = size_t(1) << log_columns;
+  // w^power = coarse_roots[power / columns] * fine_roots[power % columns]
+  std::vector<Complex> coarse_roots(rows);
+  std::vector<Complex> fine_roots(columns);
+  for (size_t row = 0; row < rows; ++row) {
+    coarse_roots[row] = Root(row * columns, log_size);
+  }
+  for (size_t column = 0; column < columns; ++column) {
+    fine_roots[column] = Root(column, log_size);
+  }
+
+  // The columns by panels copied into rows of a buffer fitting the cache,
+  // into buffer_ in the same places. The rows of buffer_ are transformed
+  // by panels and go back to the columns of the values, where the
+  // coefficient of the row k and the column l is a_(k + rows * l). So the
+  // values are read and written twice.
+  buffer_.resize(size);
+  RunInParallel(
+      columns / PANEL_WIDTH_, number_of_threads,
+      [&](size_t begin, size_t end) {
+        std::vector<Complex> panel(PANEL_WIDTH_ * rows);
+        for (size_t first_column = begin * PANEL_WIDTH_;
+             first_column < end * PANEL_WIDTH_;
+             first_column += PANEL_WIDTH_) {
+          for (size_t row = 0; row < rows; ++row) {
+            const Complex* source = values + row * columns + first_column;
+            for (size_t column = 0; column < PANEL_WIDTH_; ++column) {
+              panel[column * rows + row] = source[column];
+            }
+          }
+          for (size_t column = 0; column < PANEL_WIDTH_; ++column) {
+            Complex* transform = panel.data() + column * rows;
+            TransformIteratively(transform, rows);
+            size_t power_step = first_column + column;
+            for (size_t row = 1, power = power_step; row < rows;
+                 ++row, power += power_step) {
+              transform[row] =
+                  Multiply(transform[row],
+                           Multiply(coarse_roots[power >> log_columns],
+                                    fine_roots[power & (columns - 1)]));
+            }
+          }
+          for (size_t row = 0; row < rows; ++row) {
+            Complex* target = &buffer_[row * columns + first_column];
+            for (size_t column = 0; column < PANEL_WIDTH_; ++column) {
+              target[column] = panel[column * rows + row];
+            }
+          }
+        }
+      });
+
+  RunInParallel(
+      rows / PANEL_WIDTH_, number_of_threads,
+      [&](size_t begin, size_t end) {
+        for (size_t first_row = begin * PANEL_WIDTH_;
+             first_row < end * PANEL_WIDTH_; first_row += PANEL_WIDTH_) {
+          Complex* panel = &buffer_[first_row * columns];
+          for (size_t row = 0; row < PANEL_WIDTH_; ++row) {
+            TransformIteratively(panel + row * columns, columns);
+          }
+          for (size_t column = 0; column < columns; ++column) {
+            Complex* target = values + column * rows + first_row;
+            for (size_t row = 0; row < PANEL_WIDTH_; ++row) {
+              target[row] = panel[row * columns + column];
+            }
+          }
+        }
+      });
+}
+
+inline void FourierTransform::InverseTransformInPlace(Complex* values,
+                                                      size_t size,
+                                                      int number_of_threads) {
+  TransformInPlace(values, size, number_of_threads);
+  std::reverse(values + 1, values + size);
+  double scale = 1.0 / size;
+  for (size_t i = 0; i < size; ++i) {
+    values[i] *= scale;
+  }
+}
+
+inline void FourierTransform::RealTransform(const std::vector<double>& values,
+                                            std::vector<Complex>& spectrum,
+                                            int number_of_threads) {
+  size_t size = values.size();
+  if (size == 1) {
+    spectrum.assign(1, Complex(values[0], 0));
+    return;
+  }
+  Reserve(size);
+  size_t half = size / 2;
+  spectrum.resize(half + 1);
+  for (size_t j = 0; j < half; ++j) {
+    spectrum[j] = Complex(values[2 * j], values[2 * j + 1]);
+  }
+  TransformInPlace(spectrum.data(), half, number_of_threads);
+
+  // With z the pairs, Z their transform and w = e^(-2 pi i k / n): the even
+  // values give E_k = (Z_k + conj Z_(n/2-k)) / 2, the odd ones
+  // O_k = -i (Z_k - conj Z_(n/2-k)) / 2, and the coefficient is
+  // E_k + w O_k. The one at n/2 - k is conj(E_k - w O_k).
+  Complex first = spectrum[0];
+  spectrum[0] = Complex(first.real() + first.imag(), 0);
+  spectrum[half] = Complex(first.real() - first.imag(), 0);
+  for (size_t k = 1; 2 * k <= half; ++k) {
+    Complex lhs = spectrum[k];
+    Complex rhs = std::conj(spectrum[half - k]);
+    Complex even = 0.5 * (lhs + rhs);
+    Complex odd = Multiply(roots_[half + k],
+                           RotateClockwise(0.5 * (lhs - rhs)));
+    spectrum[k] = even + odd;
+    spectrum[half - k] = std::conj(even - odd);
+  }
+}
+
+inline void FourierTransform::InverseRealTransform(
+    const std::vector<Complex>& spectrum, size_t size,
+    std::vector<double>& values, int number_of_threads) {
+  if (size == 1) {
+    values.assign(1, spectrum[0].real());
+    return;
+  }
+  Reserve(size);
+  size_t half = size / 2;
+  // the pairs x_2j + i x_2j+1 lie in memory as the values themselves
+  values.resize(size);
+  Complex* pairs = reinterpret_cast<Complex*>(values.data());
+  for (size_t k = 0; k < half; ++k) {
+    Complex lhs = spectrum[k];
+    Complex rhs = std::conj(spectrum[half - k]);
+    Complex even = 0.5 * (lhs + rhs);
+    Complex odd = Multiply(std::conj(roots_[half + k]), 0.5 * (lhs - rhs));
+    pairs[k] = even + Complex(-odd.imag(), odd.real());
+  }
+  InverseTransformInPlace(pairs, half, number_of_threads);
+}
+
+// The transform modulo the prime 119 * 2^23 + 1 with the primitive root 3,
+// sizes up to 2^23: convolutions of integers exactly. The same iteration as
+// FourierTransform, with radix-2 butterflies.
+class NumberTheoreticTransform {
+ public:
+  constexpr static const uint32_t MODULUS_ = 998244353;
+  constexpr static const uint32_t PRIMITIVE_ROOT_ = 3;
+  constexpr static const int MAX_LOG_SIZE_ = 23;
+
+  explicit NumberTheoreticTransform(size_t max_size = 1);
+
+  // The tables for sizes up to max_size, transforms grow them as needed.
+  // Sizes above 2^MAX_LOG_SIZE_ have no root of unity modulo MODULUS_.
+  void Reserve(size_t max_size);
+
+  // values below MODULUS_, at most 2^MAX_LOG_SIZE_ of them
+  void Transform(std::vector<uint32_t>& values);
+  void InverseTransform(std::vector<uint32_t>& values);
+
+  static uint32_t Power(uint32_t base, uint64_t exponent);
+
+ private:
+  void TransformInPlace(uint32_t* values, size_t size);
+
+  // roots_[length + j] = g^(j (p - 1) / (2 length)), as in FourierTransform
+  std::vector<uint32_t> roots_;
+  std::vector<uint32_t> bit_reversal_;
+  int log_max_size_ = 0;
+};
+
+inline NumberTheoreticTransform::NumberTheoreticTransform(size_t max_size) {
+  Reserve(max_size);
+}
+
+inline uint32_t NumberTheoreticTransform::Power(uint32_t base,
+                                                uint64_t exponent) {
+  uint64_t result = 1;
+  uint64_t power = base;
+  for (; exponent > 0; exponent /= 2) {
+    if (exponent % 2 == 1) {
+      result = result * power % MODULUS_;
+    }
+    power = power * power % MODULUS_;
+  }
+  return result;
+}
+
+inline void NumberTheoreticTransform::Reserve(size_t max_size) {
+  assert(max_size <= size_t(1) << MAX_LOG_SIZE_);
+  int log_max_size = Log2(max_size);
+  if (!roots_.empty() && log_max_size <= log_max_size_) {
+    return;
+  }
+  log_max_size_ = log_max_size;
+  FillBitReversal(bit_reversal_, log_max_size_);
+  size_t size = size_t(1) << log_max_size_;
+  roots_.assign(std::max(size, size_t(2)), 1);
+  uint64_t step = Power(PRIMITIVE_ROOT_, (MODULUS_ - 1) >> log_max_size_);
+  for (size_t j = 1; j < size / 2; ++j) {
+    roots_[size / 2 + j] = roots_[size / 2 + j - 1] * step % MODULUS_;
+  }
+  for (size_t length = size / 4; length > 0; length /= 2) {
+    for (size_t j = 0; j < length; ++j) {
+      roots_[length + j] = roots_[2 * (length + j)];
+    }
+  }
+}
+
+inline void NumberTheoreticTransform::Transform(std::vector<uint32_t>& values) {
+  Reserve(values.size());
+  TransformInPlace(values.data(), values.size());
+}
+
+inline void NumberTheoreticTransform::InverseTransform(
+    std::vector<uint32_t>& values) {
+  Reserve(values.size());
+  size_t size = values.size();
+  TransformInPlace(values.data(), size);
+  std::reverse(values.begin() + 1, values.end());
+  uint64_t scale = Power(size % MODULUS_, MODULUS_ - 2);
+  for (auto&& value : values) {
+    value = value * scale % MODULUS_;
+  }
+}
+
+inline void NumberTheoreticTransform::TransformInPlace(uint32_t* values,
+                                                       size_t size) {
+  PermuteBitReversed(values, size, bit_reversal_,
+                     log_max_size_ - Log2(size));
+  for (size_t length = 1; length < size; length *= 2) {
+    for (size_t start = 0; start < size; start += 2 * length) {
+      uint32_t* half = values + start;
+      for (size_t j = 0; j < length; ++j) {
+        uint32_t first = half[j];
+        uint32_t second = uint64_t(roots_[length + j]) *
+                          half[j + length] % MODULUS_;
+        half[j] = first + second < MODULUS_ ? first + second
+                                            : first + second - MODULUS_;
+        half[j + length] =
+            first >= second ? first - second : first + MODULUS_ - second;
+      }
+    }
+  }
+}
+
+#endif  // FFT_FFT_H_
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "fft.h"
+
+// The experiment of the notebook: a function is sampled at 128 points of
+// [0, T), the last coefficients of its transform are dropped, and the
+// inverse transform is compared with the samples. Prints the greatest
+// deviation of the real part relative to the greatest sample.
+class TruncationExperiment {
+ public:
+  void operator()() {
+    std::function<double(double)> functions[] = {
+        [](double x) { return x; },
+        [](double x) { return x * x; },
+        [](double x) { return std::sin(x); },
+        [](double x) { return std::sin(x * x); },
+        [](double x) { return x == 0 ? 1.0 : std::sin(x) / x; }};
+    const char* names[] = {"x", "x^2", "sin x", "sin x^2", "sin x / x"};
+
+    printf("%-10s %4s", "function", "T");
+    for (int dropped : DROPPED_) {
+      printf(" %9.1f%%", 100.0 * dropped / SIZE_);
+    }
+    printf("\n");
+    for (int function = 0; function < 5; ++function) {
+      for (double period : PERIODS_) {
+        printf("%-10s %4.0f", names[function], period);
+        for (int dropped : DROPPED_) {
+          printf(" %9.2f%%",
+                 100 * Deviation(functions[function], period, dropped));
+        }
+        printf("\n");
+      }
+    }
+  }
+
+ private:
+  constexpr static const int SIZE_ = 128;
+  constexpr static const int DROPPED_[] = {0, 1, 2, 3, 4, 64};
+  constexpr static const double PERIODS_[] = {10, 50};
+
+  double Deviation(const std::function<double(double)>& function,
+                   double period, int dropped) {
+    std::vector<Complex> values(SIZE_);
+    for (int i = 0; i < SIZE_; ++i) {
+      values[i] = function(period * i / SIZE_);
+    }
+    std::vector<Complex> spectrum = values;
+    transform_.Transform(spectrum);
+    std::fill(spectrum.end() - dropped, spectrum.end(), Complex(0, 0));
+    transform_.InverseTransform(spectrum);
+
+    double deviation = 0;
+    double greatest = 0;
+    for (int i = 0; i < SIZE_; ++i) {
+      deviation = std::max(deviation,
+                           std::abs(spectrum[i].real() - values[i].real()));
+      greatest = std::max(greatest, std::abs(values[i].real()));
+    }
+    return deviation / greatest;
+  }
+
+  FourierTransform transform_;
+};
+
+int main() {
+  TruncationExperiment experiment;
+
+  experiment();
+
+  return 0;
+}